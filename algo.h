@@ -21,6 +21,15 @@
 #include "hash.h"
 #include "trie.h"
 #include "dictionary.h"
+#include "chashtable.h"
+#include "swisstable.h"
+#include "arena.h"
+#include "dictimage.h"
+#include "hashtable_tmpl.h"
+#include "shardtable.h"
+#include "intern.h"
+#include "vdict.h"
+#include "dictfile.h"
 
 #endif
 
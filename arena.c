@@ -0,0 +1,160 @@
+/**
+ * @file   arena.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 14:29:50 2026
+ *
+ * @brief  A bump allocator. More documentation in arena.h
+ *
+ *
+ */
+
+#include "arena.h"
+
+/**
+ * Private functions
+ *
+ */
+static arena_chunk *newchunk(arena *a, size_t size);
+
+/* Everything handed out is aligned to the strictest of these */
+typedef union arena_align_u {
+  long l;
+  double d;
+  void *p;
+  void (*f)(void);
+} arena_align;
+
+#define ALIGNUP(n) (((n) + sizeof(arena_align) - 1)	\
+		    & ~(sizeof(arena_align) - 1))
+
+/* Chunk headers are padded so the space after them is aligned */
+#define HEADERSIZE ALIGNUP(sizeof(arena_chunk))
+
+
+arena *arena_new(size_t chunksize)
+{
+  arena *a;
+
+  a = calloc(1, sizeof(*a));
+  if(a == NULL) {
+    return NULL;
+  }
+
+  a->chunks = NULL;
+  a->chunksize = (chunksize == 0) ? ARENA_CHUNKSIZE : chunksize;
+  a->allocated = 0;
+
+  return a;
+}
+
+void arena_free(arena *a)
+{
+  arena_chunk *c, *next;
+
+  if(a == NULL) {
+    return;
+  }
+
+  for(c = a->chunks; c != NULL; c = next) {
+    next = c->next;
+    free(c);
+  }
+
+  free(a);
+}
+
+void *arena_alloc(arena *a, size_t size)
+{
+  arena_chunk *c;
+  void *p;
+
+  if(a == NULL) {
+    return NULL;
+  }
+
+  if(size > ((size_t)-1) - sizeof(arena_align)) {
+    return NULL;
+  }
+
+  size = ALIGNUP(size);
+  if(size == 0) {
+    /* still hand out a distinct pointer */
+    size = sizeof(arena_align);
+  }
+
+  c = a->chunks;
+  if((c == NULL) ||
+     (c->size - c->used < size)) {
+    c = newchunk(a, size);
+    if(c == NULL) {
+      return NULL;
+    }
+  }
+
+  p = (char*)c + HEADERSIZE + c->used;
+  c->used += size;
+  a->allocated += size;
+
+  return p;
+}
+
+void *arena_memdup(arena *a, const void *data, size_t len)
+{
+  void *p;
+
+  p = arena_alloc(a, len);
+  if(p == NULL) {
+    return NULL;
+  }
+
+  memcpy(p, data, len);
+  return p;
+}
+
+char *arena_strdup(arena *a, const char *string)
+{
+  if(string == NULL) {
+    return NULL;
+  }
+
+  return (char*)arena_memdup(a, string, strlen(string) + 1);
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* Get a chunk with room for size bytes.  An oversized request   */
+/* gets its own chunk, put behind the current one so the space   */
+/* left in that is not wasted.  Returns the chunk to allocate    */
+/* from, or NULL if out of memory.                               */
+static arena_chunk *newchunk(arena *a, size_t size)
+{
+  arena_chunk *c;
+  size_t space;
+
+  space = (size > a->chunksize) ? size : a->chunksize;
+  if(space > ((size_t)-1) - HEADERSIZE) {
+    return NULL;
+  }
+
+  c = malloc(HEADERSIZE + space);
+  if(c == NULL) {
+    return NULL;
+  }
+  c->size = space;
+  c->used = 0;
+
+  if((size > a->chunksize) &&
+     (a->chunks != NULL)) {
+    c->next = a->chunks->next;
+    a->chunks->next = c;
+  } else {
+    c->next = a->chunks;
+    a->chunks = c;
+  }
+
+  return c;
+}
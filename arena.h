@@ -0,0 +1,87 @@
+/**
+ * @file   arena.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 14:21:37 2026
+ *
+ * @brief A bump allocator. Memory is carved out of large chunks and
+ * is all given back at once by arena_free, so many small allocations
+ * cost about as much as one.
+ *
+ *
+ */
+
+#ifndef _ARENA_H_
+#define _ARENA_H_
+
+#include <stdlib.h>
+#include <string.h>
+
+/* default bytes per chunk, used when arena_new is given 0 */
+#define ARENA_CHUNKSIZE 65536
+
+typedef struct arena_chunk_s arena_chunk;
+struct arena_chunk_s {
+  arena_chunk *next;
+  size_t size;         /* bytes of space after the header */
+  size_t used;
+};
+
+typedef struct arena_s arena;
+struct arena_s {
+  arena_chunk *chunks;   /* newest first, allocations come from it */
+  size_t chunksize;
+  size_t allocated;      /* bytes handed out */
+};
+
+/**
+ * Creates a new, empty arena
+ *
+ * @param chunksize bytes to get from malloc at a time, or 0 for
+ *                  ARENA_CHUNKSIZE. Larger requests get a chunk of
+ *                  their own
+ *
+ * @return the arena, or NULL on failure
+ */
+arena *arena_new(size_t chunksize);
+
+/**
+ * Frees an arena and everything allocated from it. Will accept NULL
+ * gracefully
+ *
+ * @param a the arena
+ */
+void arena_free(arena *a);
+
+/**
+ * Allocates size bytes, aligned for any type. The memory is not
+ * zeroed, and can not be given back on its own
+ *
+ * @param a the arena
+ * @param size the number of bytes
+ *
+ * @return the memory, or NULL on failure
+ */
+void *arena_alloc(arena *a, size_t size);
+
+/**
+ * Copies len bytes into the arena
+ *
+ * @param a the arena
+ * @param data the bytes to copy
+ * @param len how many
+ *
+ * @return the copy, or NULL on failure
+ */
+void *arena_memdup(arena *a, const void *data, size_t len);
+
+/**
+ * Copies a string into the arena
+ *
+ * @param a the arena
+ * @param string the string to copy
+ *
+ * @return the copy, or NULL on failure
+ */
+char *arena_strdup(arena *a, const char *string);
+
+#endif /* _ARENA_H_ */
@@ -0,0 +1,144 @@
+/**
+ * @file   tmplbench.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 20:31:05 2026
+ *
+ * @brief Times lookups in a HASHTABLE_DECLARE table against the same
+ * lookups through hashtable_find, on unsigned long keys. Both tables
+ * probe the same way (HSH_POW2 | HSH_CACHEHASH), so the difference is
+ * what specialising for the type buys. Build with make bench, and
+ * run as
+ *
+ *   bench/tmplbench [keys [rounds]]
+ *
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../hashtable.h"
+#include "../hashtable_tmpl.h"
+
+#define BENCH_KEYS   2000000UL
+#define BENCH_ROUNDS 5UL
+
+/* Knuth's multiplicative hash */
+#define ULHASH(k) ((unsigned long)(k) * 2654435761UL)
+#define ULEQ(a, b) ((a) == (b))
+
+HASHTABLE_DECLARE(ulmap, unsigned long, unsigned long, ULHASH, ULEQ)
+
+/**
+ * Private functions
+ *
+ */
+static unsigned long ul_hash(void *item);
+static unsigned long ul_rehash(void *item);
+static int ul_cmp(void *a, void *b);
+static double seconds(clock_t from);
+
+
+int main(int argc, char **argv)
+{
+  ulmap *t;
+  hashtable *m;
+  unsigned long *keys, nkeys, rounds, i, r, k, hits[2];
+  clock_t start;
+  double tt, tm;
+
+  nkeys = (argc > 1) ? strtoul(argv[1], NULL, 10) : BENCH_KEYS;
+  rounds = (argc > 2) ? strtoul(argv[2], NULL, 10) : BENCH_ROUNDS;
+  if(nkeys == 0) {
+    nkeys = BENCH_KEYS;
+  }
+
+  /* the hashtable holds pointers into keys, so it needs no dupe */
+  keys = malloc(nkeys * sizeof(*keys));
+  t = ulmap_new();
+  m = hashtable_new_flags(ul_hash, ul_rehash, ul_cmp, NULL, NULL,
+			  HSH_POW2 | HSH_CACHEHASH);
+  if((keys == NULL) ||
+     (t == NULL) ||
+     (m == NULL)) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+
+  /* every other key looked up below is there */
+  for(i = 0; i < nkeys; i++) {
+    keys[i] = i * 2;
+    if((ulmap_insert(t, keys[i], i) == NULL) ||
+       (hashtable_insert(m, &keys[i]) == NULL)) {
+      fprintf(stderr, "insert failed\n");
+      return 1;
+    }
+  }
+
+  hits[0] = hits[1] = 0;
+
+  start = clock();
+  for(r = 0; r < rounds; r++) {
+    for(i = 0; i < nkeys; i++) {
+      if(ulmap_find(t, i) != NULL) {
+	hits[0]++;
+      }
+    }
+  }
+  tt = seconds(start);
+
+  start = clock();
+  for(r = 0; r < rounds; r++) {
+    for(i = 0; i < nkeys; i++) {
+      k = i;
+      if(hashtable_find(m, &k) != NULL) {
+	hits[1]++;
+      }
+    }
+  }
+  tm = seconds(start);
+
+  if(hits[0] != hits[1]) {
+    fprintf(stderr, "tables disagree: %lu and %lu hits\n", hits[0], hits[1]);
+    return 1;
+  }
+
+  printf("%lu keys, %lu lookups, %lu hits\n", nkeys, nkeys * rounds, hits[0]);
+  printf("HASHTABLE_DECLARE  %.3fs\n", tt);
+  printf("hashtable_find     %.3fs\n", tm);
+  if(tt > 0) {
+    printf("speedup            %.2fx\n", tm / tt);
+  }
+
+  ulmap_free(t);
+  hashtable_free(m);
+  free(keys);
+  return 0;
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+static unsigned long ul_hash(void *item)
+{
+  return ULHASH(*(unsigned long*)item);
+}
+
+static unsigned long ul_rehash(void *item)
+{
+  return *(unsigned long*)item ^ (*(unsigned long*)item >> 7);
+}
+
+static int ul_cmp(void *a, void *b)
+{
+  return *(unsigned long*)a != *(unsigned long*)b;
+}
+
+static double seconds(clock_t from)
+{
+  return (double)(clock() - from) / CLOCKS_PER_SEC;
+}
@@ -0,0 +1,419 @@
+/**
+ * @file   chashtable.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 11:31:08 2026
+ *
+ * @brief  A hash map shared between threads. More documentation in
+ * chashtable.h
+ *
+ *
+ */
+
+#include "chashtable.h"
+
+/**
+ * Private functions
+ *
+ */
+static chtable *newchtable(unsigned long size);
+static void *store(chashtable *m, void *item, int replacing);
+static unsigned long wlocate(chashtable *m, chtable *t,
+			     void *item, unsigned long hv);
+static void place(chtable *t, void *item, unsigned long hv);
+static int rebuild(chashtable *m);
+
+/* starting size, a power of 2 */
+#define CHASHTABLE_STARTSIZE 16
+
+/* Threshold of used slots above which the table is rebuilt */
+#define TTHRESH(sz) (sz - (sz >> 3))
+
+
+chashtable *chashtable_new(hshfn hash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe)
+{
+  chashtable *m;
+
+  if((hash == NULL) ||
+     (cmp == NULL)) {
+    return NULL;
+  }
+
+  m = calloc(1, sizeof(*m));
+  if(m == NULL) {
+    return NULL;
+  }
+
+  m->tbl = newchtable(CHASHTABLE_STARTSIZE);
+  if(m->tbl == NULL) {
+    free(m);
+    return NULL;
+  }
+
+  m->readers = epoch_new();
+  if(m->readers == NULL) {
+    free(m->tbl);
+    free(m);
+    return NULL;
+  }
+
+  if(pthread_mutex_init(&m->wlock, NULL) != 0) {
+    epoch_free(m->readers);
+    free(m->tbl);
+    free(m);
+    return NULL;
+  }
+
+  m->hash = hash;
+  m->cmp = cmp;
+  m->dupe = dupe;
+  m->undupe = undupe;
+
+  /* initialise the status portion */
+  m->hstatus.probes = m->hstatus.misses = 0;
+  m->hstatus.hentries = 0;
+  m->hstatus.hdeleted = 0;
+  m->hstatus.herror = hshOK;
+
+  return m;
+}
+
+void chashtable_free(chashtable *m)
+{
+  unsigned long i;
+  void *hh;
+
+  if(m == NULL) {
+    return;
+  }
+
+  for(i = 0; i < m->tbl->size; i++) {
+    hh = m->tbl->slots[i].item;
+    if((hh != NULL) &&
+       (hh != (void*)m) &&
+       (m->undupe != NULL)) {
+      m->undupe(hh);
+    }
+  }
+  free(m->tbl);
+
+  /* releases whatever was still waiting on readers */
+  epoch_free(m->readers);
+
+  pthread_mutex_destroy(&m->wlock);
+  free(m);
+}
+
+epoch_thread *chashtable_register(chashtable *m)
+{
+  if(m == NULL) {
+    return NULL;
+  }
+
+  return epoch_register(m->readers);
+}
+
+void chashtable_unregister(epoch_thread *t)
+{
+  epoch_unregister(t);
+}
+
+void chashtable_enter(chashtable *m, epoch_thread *t)
+{
+  epoch_enter(m->readers, t);
+}
+
+void chashtable_exit(epoch_thread *t)
+{
+  epoch_exit(t);
+}
+
+void *chashtable_find(chashtable *m, void *item)
+{
+  chtable *t;
+  unsigned long h, hv, mask;
+  void *hh;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = m->hash(item);
+  t = __atomic_load_n(&m->tbl, __ATOMIC_ACQUIRE);
+  mask = t->size - 1;
+
+  /* the hash is written before the item is published, and never */
+  /* changes afterwards, so it is safe to read once hh is seen   */
+  for(h = hshmix(hv) & mask; ; h = (h + 1) & mask) {
+    hh = __atomic_load_n(&t->slots[h].item, __ATOMIC_ACQUIRE);
+    if(hh == NULL) {
+      return NULL;
+    }
+    if((hh != (void*)m) &&
+       (t->slots[h].hval == hv) &&
+       (0 == m->cmp(hh, item))) {
+      return hh;
+    }
+  }
+}
+
+void *chashtable_insert(chashtable *m, void *item)
+{
+  if(m == NULL) {
+    return NULL;
+  }
+
+  return store(m, item, 0);
+}
+
+void *chashtable_replace(chashtable *m, void *item)
+{
+  if(m == NULL) {
+    return NULL;
+  }
+
+  return store(m, item, 1);
+}
+
+int chashtable_remove(chashtable *m, void *item)
+{
+  chtable *t;
+  unsigned long h, hv;
+  void *olditem;
+
+  if(m == NULL) {
+    return 0;
+  }
+
+  hv = m->hash(item);
+
+  pthread_mutex_lock(&m->wlock);
+  t = m->tbl;
+  h = wlocate(m, t, item, hv);
+  if(h >= t->size) {
+    pthread_mutex_unlock(&m->wlock);
+    return 0;
+  }
+
+  /* the slot stays used until the next rebuild, so probe chains */
+  /* through it are not broken                                   */
+  olditem = t->slots[h].item;
+  __atomic_store_n(&t->slots[h].item, (void*)m, __ATOMIC_RELEASE);
+  m->hstatus.hentries--;
+  m->hstatus.hdeleted++;
+  pthread_mutex_unlock(&m->wlock);
+
+  if(m->undupe != NULL) {
+    epoch_retire(m->readers, olditem, m->undupe);
+  }
+  epoch_reclaim(m->readers);
+
+  return 1;
+}
+
+int chashtable_foreach(chashtable *m, hshexecfn exec, void *datum)
+{
+  chtable *t;
+  unsigned long i;
+  void *hh;
+  int err;
+
+  if((m == NULL) ||
+     (exec == NULL)) {
+    return -1;
+  }
+
+  t = __atomic_load_n(&m->tbl, __ATOMIC_ACQUIRE);
+  for(i = 0; i < t->size; i++) {
+    hh = __atomic_load_n(&t->slots[i].item, __ATOMIC_ACQUIRE);
+    if((hh != NULL) &&
+       (hh != (void*)m)) {
+      err = exec(hh, datum);
+      if(err != 0) {
+	return err;
+      }
+    }
+  }
+
+  return 0;
+}
+
+void chashtable_stats(chashtable *m, hshstats *stats)
+{
+  if((m == NULL) ||
+     (stats == NULL)) {
+    return;
+  }
+
+  pthread_mutex_lock(&m->wlock);
+  *stats = m->hstatus;
+  pthread_mutex_unlock(&m->wlock);
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* An empty table of size slots, in one allocation so that */
+/* it can be retired with a plain free                     */
+static chtable *newchtable(unsigned long size)
+{
+  chtable *t;
+
+  if(size > (((unsigned long)-1) - sizeof(*t)) / sizeof(hshslot)) {
+    return NULL;
+  }
+
+  t = calloc(1, sizeof(*t) + size * sizeof(hshslot));
+  if(t == NULL) {
+    return NULL;
+  }
+
+  t->size = size;
+  t->used = 0;
+  t->slots = (hshslot*)(t + 1);
+
+  return t;
+}
+
+/* Insert item, or replace the equal item already stored. */
+/* Returns the stored item, or NULL on failure            */
+static void *store(chashtable *m, void *item, int replacing)
+{
+  chtable *t;
+  unsigned long h, hv;
+  void *stored, *olditem;
+
+  hv = m->hash(item);
+  olditem = NULL;
+
+  pthread_mutex_lock(&m->wlock);
+  t = m->tbl;
+  h = wlocate(m, t, item, hv);
+
+  if((h < t->size) && !replacing) {
+    /* found already inserted here */
+    stored = t->slots[h].item;
+    pthread_mutex_unlock(&m->wlock);
+    return stored;
+  }
+
+  if((h >= t->size) &&
+     (t->used >= TTHRESH(t->size))) {
+    if(!rebuild(m)) {
+      m->hstatus.herror |= hshTBLFULL;
+      pthread_mutex_unlock(&m->wlock);
+      return NULL;
+    }
+    t = m->tbl;
+  }
+
+  stored = (m->dupe == NULL) ? item : m->dupe(item);
+  if(stored == NULL) {
+    m->hstatus.herror |= hshNOMEM;
+    pthread_mutex_unlock(&m->wlock);
+    return NULL;
+  }
+
+  if(h < t->size) {
+    /* same key, so the cached hash stands */
+    olditem = t->slots[h].item;
+    __atomic_store_n(&t->slots[h].item, stored, __ATOMIC_RELEASE);
+  } else {
+    place(t, stored, hv);
+    m->hstatus.hentries++;
+  }
+  pthread_mutex_unlock(&m->wlock);
+
+  if((olditem != NULL) &&
+     (m->undupe != NULL)) {
+    epoch_retire(m->readers, olditem, m->undupe);
+  }
+  epoch_reclaim(m->readers);
+
+  return stored;
+}
+
+/* Writer side lookup, with the lock held.  Returns the */
+/* slot holding item, or the table size if it is absent */
+static unsigned long wlocate(chashtable *m, chtable *t,
+			     void *item, unsigned long hv)
+{
+  unsigned long h, mask;
+  void *hh;
+
+  mask = t->size - 1;
+  for(h = hshmix(hv) & mask; ; h = (h + 1) & mask) {
+    m->hstatus.probes++;
+    hh = t->slots[h].item;
+    if(hh == NULL) {
+      return t->size;
+    }
+    if((hh != (void*)m) &&
+       (t->slots[h].hval == hv) &&
+       (0 == m->cmp(hh, item))) {
+      return h;
+    }
+    m->hstatus.misses++;
+  }
+}
+
+/* Put item in the first empty slot of its probe sequence.  */
+/* DELETED slots are not reused: a reader may be part way   */
+/* along a chain through one, and the cached hash has to    */
+/* stay with the item that it was read alongside.           */
+static void place(chtable *t, void *item, unsigned long hv)
+{
+  unsigned long h, mask;
+
+  mask = t->size - 1;
+  for(h = hshmix(hv) & mask;
+      t->slots[h].item != NULL;
+      h = (h + 1) & mask) {
+    /* empty */
+  }
+
+  t->slots[h].hval = hv;
+  __atomic_store_n(&t->slots[h].item, item, __ATOMIC_RELEASE);
+  t->used++;
+}
+
+/* Copy the live items into a new table, doubled if needed to  */
+/* leave it no more than half full, and publish it.  Readers   */
+/* still in the old table keep it until they are done.         */
+static int rebuild(chashtable *m)
+{
+  chtable *oldt, *newt;
+  unsigned long i, newsize;
+  void *hh;
+
+  oldt = m->tbl;
+  newsize = oldt->size;
+  while(TTHRESH(newsize) / 2 < m->hstatus.hentries + 1) {
+    if((newsize << 1) < newsize) {
+      return 0;
+    }
+    newsize <<= 1;
+  }
+
+  newt = newchtable(newsize);
+  if(newt == NULL) {
+    return 0;
+  }
+
+  for(i = 0; i < oldt->size; i++) {
+    hh = oldt->slots[i].item;
+    if((hh != NULL) &&
+       (hh != (void*)m)) {
+      place(newt, hh, oldt->slots[i].hval);
+    }
+  }
+
+  __atomic_store_n(&m->tbl, newt, __ATOMIC_RELEASE);
+  m->hstatus.hdeleted = 0;
+
+  epoch_retire(m->readers, oldt, free);
+  return 1;
+}
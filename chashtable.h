@@ -0,0 +1,176 @@
+/**
+ * @file   chashtable.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 11:05:52 2026
+ *
+ * @brief A hash map that one table can share between many threads.
+ * Lookups take no locks and write nothing shared; writers take a
+ * mutex. Uses the same item callbacks as hashtable.
+ *
+ *
+ */
+
+#ifndef _CHASHTABLE_H_
+#define _CHASHTABLE_H_
+
+#include <pthread.h>
+
+#include "hashtable.h"
+#include "epoch.h"
+
+/* Every thread that looks things up gets a record from             */
+/* chashtable_register(), and brackets its lookups with             */
+/* chashtable_enter() and chashtable_exit().  Pointers returned by  */
+/* chashtable_find() stay valid until chashtable_exit(), even if a  */
+/* writer removes or replaces the item meanwhile: removed items and */
+/* outgrown tables are only released (items through undupe) once   */
+/* every reader that could have seen them has left.                 */
+
+/* Writers are serialised on a mutex, and the table grows by        */
+/* building a new one and publishing it, so readers never wait.     */
+/* Like HSH_ROBINHOOD it uses linear probing on a power of two      */
+/* size with cached hashes, so rehash is not called.                */
+
+/* one table of slots; replaced wholesale when it grows */
+typedef struct chtable_s chtable;
+struct chtable_s {
+  unsigned long size;        /* a power of 2 */
+  unsigned long used;        /* live and DELETED slots */
+  hshslot *slots;
+};
+
+typedef struct chashtable_s chashtable;
+struct chashtable_s {
+  chtable *tbl;              /* current table, read without locking */
+  hshfn hash;
+  hshcmpfn cmp;
+  hshdupfn dupe;
+  hshfreefn undupe;
+  epoch *readers;            /* holds retired items and tables */
+  pthread_mutex_t wlock;     /* serialises writers */
+  hshstats hstatus;          /* kept up by writers only */
+};
+
+/**
+ * Creates a new concurrent hashtable, returns a pointer to it, or
+ * NULL on failure
+ *
+ * @param hash the hashing function
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function, also used on removed items
+ *
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+chashtable *chashtable_new(hshfn hash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe);
+
+/**
+ * Frees a concurrent hashtable and every item in it. No other thread
+ * may be using it. Will accept NULL gracefully
+ *
+ * @param m the hashtable
+ */
+void chashtable_free(chashtable *m);
+
+/**
+ * Registers the calling thread as a reader of the table
+ *
+ * @param m the hashtable
+ *
+ * @return the thread's record, or NULL on failure
+ */
+epoch_thread *chashtable_register(chashtable *m);
+
+/**
+ * Gives up a record from chashtable_register
+ *
+ * @param t the record
+ */
+void chashtable_unregister(epoch_thread *t);
+
+/**
+ * Starts a run of lookups. Does not block
+ *
+ * @param m the hashtable
+ * @param t the calling thread's record
+ */
+void chashtable_enter(chashtable *m, epoch_thread *t);
+
+/**
+ * Ends a run of lookups. Pointers found since chashtable_enter must
+ * not be used after this
+ *
+ * @param t the calling thread's record
+ */
+void chashtable_exit(epoch_thread *t);
+
+/**
+ * Locates an item in the table without locking. Must be called
+ * between chashtable_enter and chashtable_exit
+ *
+ * @param m the hashtable
+ * @param item the item you are looking for
+ *
+ * @return a pointer to the item in the table, or NULL if not found
+ */
+void *chashtable_find(chashtable *m, void *item);
+
+/**
+ * Inserts an item, unless an equal one is there already. The
+ * returned pointer may only be used inside a chashtable_enter
+ * bracket, as another thread could remove it
+ *
+ * @param m the hashtable
+ * @param item the item to insert
+ *
+ * @return the address of the stored item, or NULL on failure
+ */
+void *chashtable_insert(chashtable *m, void *item);
+
+/**
+ * Inserts an item, replacing any equal one. A replaced item is
+ * passed to undupe once no reader can still be using it
+ *
+ * @param m the hashtable
+ * @param item the item to store
+ *
+ * @return the address of the stored item, or NULL on failure
+ */
+void *chashtable_replace(chashtable *m, void *item);
+
+/**
+ * Removes an item. It is passed to undupe once no reader can still
+ * be using it
+ *
+ * @param m the hashtable
+ * @param item the item to remove
+ *
+ * @return 1 if it was removed, 0 if it was not there
+ */
+int chashtable_remove(chashtable *m, void *item);
+
+/**
+ * Executes exec for each item in the table (no guaranteed order).
+ * Must be called between chashtable_enter and chashtable_exit; items
+ * inserted or removed meanwhile may or may not be seen
+ *
+ * @param m the hashtable
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure
+ * @param datum data that the exec function will have access to.
+ *
+ * @return 0 on success, other on failure
+ */
+int chashtable_foreach(chashtable *m, hshexecfn exec, void *datum);
+
+/**
+ * Copies out the table statistics. probes and misses only count
+ * writer probes; lookups do not touch shared state
+ *
+ * @param m the hashtable
+ * @param stats where to put them
+ */
+void chashtable_stats(chashtable *m, hshstats *stats);
+
+#endif /* _CHASHTABLE_H_ */
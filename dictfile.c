@@ -0,0 +1,239 @@
+/**
+ * @file   dictfile.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 19:52:44 2026
+ *
+ * @brief  key=value files for dictionaries. More documentation in
+ * dictfile.h
+ *
+ *
+ */
+
+/* mmap and friends are POSIX, not ANSI */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dictfile.h"
+
+/**
+ * Private functions
+ *
+ */
+static int loadbuf(dictionary *d, const char *buf, size_t len);
+static unsigned long countlines(const char *buf, size_t len);
+static int dumpitem(void *item, void *datum);
+
+/* lines parsed before they are handed to hashtable_insert_batch */
+#define DICTFILE_BATCH 256
+
+/* stdio buffer for dumping */
+#define DICTFILE_BUFSIZE 65536
+
+
+int dictionary_load(dictionary *d, const char *path)
+{
+  struct stat st;
+  void *base;
+  int fd, err;
+
+  if((d == NULL) ||
+     (path == NULL)) {
+    return -1;
+  }
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    return -1;
+  }
+
+  if(fstat(fd, &st) != 0) {
+    close(fd);
+    return -1;
+  }
+
+  if(st.st_size == 0) {
+    /* there is nothing to map */
+    close(fd);
+    return 0;
+  }
+
+  base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) {
+    return -1;
+  }
+
+  err = loadbuf(d, (const char*)base, (size_t)st.st_size);
+
+  munmap(base, (size_t)st.st_size);
+  return err;
+}
+
+int dictionary_dump(dictionary *d, const char *path)
+{
+  char *tmppath;
+  FILE *f;
+  int err;
+
+  if((d == NULL) ||
+     (path == NULL)) {
+    return -1;
+  }
+
+  /* write it beside the old one and rename it into place, so a */
+  /* failure part way leaves the old one whole                  */
+  tmppath = malloc(strlen(path) + 5);
+  if(tmppath == NULL) {
+    return -1;
+  }
+  strcpy(tmppath, path);
+  strcat(tmppath, ".tmp");
+
+  f = fopen(tmppath, "wb");
+  if(f == NULL) {
+    free(tmppath);
+    return -1;
+  }
+
+  err = 0;
+  if((setvbuf(f, NULL, _IOFBF, DICTFILE_BUFSIZE) != 0) ||
+     (hashtable_foreach((hashtable*)d, dumpitem, f) != 0)) {
+    err = -1;
+  }
+
+  if(fclose(f) != 0) {
+    err = -1;
+  }
+  if(err == 0) {
+    err = (rename(tmppath, path) == 0) ? 0 : -1;
+  }
+  if(err != 0) {
+    remove(tmppath);
+  }
+
+  free(tmppath);
+  return err;
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* Parse len bytes of lines into items that point straight into */
+/* buf, and insert them a batch at a time.  hashtable_insert    */
+/* copies them out, so nothing is allocated per line here.      */
+static int loadbuf(dictionary *d, const char *buf, size_t len)
+{
+  dictionary_item items[DICTFILE_BATCH];
+  void *batch[DICTFILE_BATCH];
+  const char *p, *end, *eol, *le, *eq;
+  size_t n;
+
+  if(hashtable_reserve((hashtable*)d, countlines(buf, len)) != 0) {
+    return -1;
+  }
+
+  for(n = 0; n < DICTFILE_BATCH; n++) {
+    batch[n] = &items[n];
+  }
+
+  n = 0;
+  end = buf + len;
+  for(p = buf; p < end; p = (eol < end) ? eol + 1 : end) {
+    eol = memchr(p, '\n', end - p);
+    if(eol == NULL) {
+      eol = end;
+    }
+
+    le = eol;
+    if((le > p) && (le[-1] == '\r')) {
+      le--;
+    }
+    if(le == p) {
+      continue;
+    }
+
+    eq = memchr(p, '=', le - p);
+    if(eq == NULL) {
+      break;
+    }
+
+    items[n].key = (char*)p;
+    items[n].klen = eq - p;
+    items[n].value = (char*)eq + 1;
+    items[n].vlen = le - eq - 1;
+    items[n].vcap = 0;
+    items[n].hval = DICTIONARY_HASH2(p, items[n].klen, &items[n].rval);
+
+    if(++n == DICTFILE_BATCH) {
+      if(hashtable_insert_batch((hashtable*)d, batch, NULL, n) != n) {
+	return -1;
+      }
+      n = 0;
+    }
+  }
+
+  if((n > 0) &&
+     (hashtable_insert_batch((hashtable*)d, batch, NULL, n) != n)) {
+    return -1;
+  }
+
+  /* stopped early on a line with no '=' */
+  return (p < end) ? -1 : 0;
+}
+
+/* The number of lines in buf, counting an unterminated last one */
+static unsigned long countlines(const char *buf, size_t len)
+{
+  const char *p, *end;
+  unsigned long n;
+
+  n = 0;
+  end = buf + len;
+  for(p = buf; (p = memchr(p, '\n', end - p)) != NULL; p++) {
+    n++;
+  }
+
+  if((len > 0) &&
+     (buf[len - 1] != '\n')) {
+    n++;
+  }
+
+  return n;
+}
+
+/* Write item as a line, failing on one that would not load back */
+static int dumpitem(void *item, void *datum)
+{
+  dictionary_item *di;
+  FILE *f;
+
+  di = (dictionary_item*)item;
+  f = (FILE*)datum;
+
+  /* a '\r' at the end of the value would be taken for part of */
+  /* a "\r\n" line ending                                      */
+  if((memchr(di->key, '=', di->klen) != NULL) ||
+     (memchr(di->key, '\n', di->klen) != NULL) ||
+     (memchr(di->value, '\n', di->vlen) != NULL) ||
+     ((di->vlen > 0) && (di->value[di->vlen - 1] == '\r'))) {
+    return -1;
+  }
+
+  if((fwrite(di->key, 1, di->klen, f) != di->klen) ||
+     (putc('=', f) == EOF) ||
+     (fwrite(di->value, 1, di->vlen, f) != di->vlen) ||
+     (putc('\n', f) == EOF)) {
+    return -1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,51 @@
+/**
+ * @file   dictfile.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 19:40:18 2026
+ *
+ * @brief Loading a dictionary from, and dumping it to, a text file
+ * of key=value lines.
+ *
+ *
+ */
+
+#ifndef _DICTFILE_H_
+#define _DICTFILE_H_
+
+#include "dictionary.h"
+
+/* A line is split at its first '=', so values may hold '=' but    */
+/* keys may not, and neither may hold a newline.  A '\r' before    */
+/* the newline is dropped, and blank lines are skipped.  Nothing   */
+/* is trimmed or unescaped, and a key may be empty.  So an item    */
+/* can not be dumped if its key holds '=' or '\n', or its value    */
+/* holds '\n' or ends in '\r'.                                     */
+
+/**
+ * Adds every line of a file to a dictionary. The file is mapped
+ * rather than read, the table is grown once for all of its lines,
+ * and they are inserted straight from the mapping in batches. As
+ * with dictionary_set, a key already there keeps its value
+ *
+ * @param d the dictionary
+ * @param path the file
+ *
+ * @return 0 on success, other on failure or if a non-blank line has
+ *         no '='; the lines before it are in the dictionary
+ */
+int dictionary_load(dictionary *d, const char *path);
+
+/**
+ * Writes every item of a dictionary to a file, one key=value line
+ * each, in no particular order
+ *
+ * @param d the dictionary
+ * @param path the file to write, replaced if it exists
+ *
+ * @return 0 on success, other on failure or if an item could not be
+ *         read back by dictionary_load; the file is then left as it
+ *         was
+ */
+int dictionary_dump(dictionary *d, const char *path);
+
+#endif /* _DICTFILE_H_ */
@@ -0,0 +1,345 @@
+/**
+ * @file   dictimage.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 16:47:30 2026
+ *
+ * @brief  Memory-mapped dictionary images. More documentation in
+ * dictimage.h
+ *
+ *
+ */
+
+/* mmap and friends are POSIX, not ANSI */
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "dictimage.h"
+
+/**
+ * Private functions
+ *
+ */
+static int countitem(void *item, void *datum);
+static int placeitem(void *item, void *datum);
+static int writeitem(void *item, void *datum);
+static const dictimage_record *record(dictimage *img, unsigned long off);
+
+/* Bytes taken by a record with these key and value lengths */
+#define WORDUP(n) (((n) + sizeof(unsigned long) - 1)	\
+		   & ~(sizeof(unsigned long) - 1))
+#define RECSIZE(klen, vlen) WORDUP(sizeof(dictimage_record)	\
+				   + (klen) + 1 + (vlen) + 1)
+
+#define BYTEORDER 0x01020304UL
+
+/* what the foreach callbacks of dictionary_save share */
+typedef struct saver_s saver;
+struct saver_s {
+  unsigned long count;
+  dictimage_slot *slots;
+  unsigned long mask;
+  unsigned long off;           /* where the next record goes */
+  FILE *f;
+};
+
+
+int dictionary_save(dictionary *d, const char *path)
+{
+  dictimage_header header;
+  saver sv;
+  char *tmppath;
+  int err;
+
+  if((d == NULL) ||
+     (path == NULL)) {
+    return -1;
+  }
+
+  sv.count = 0;
+  (void) hashtable_foreach((hashtable*)d, countitem, &sv);
+
+  /* keep it no more than half full, lookups that miss stay short */
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, DICTIMAGE_MAGIC, sizeof(header.magic));
+  header.byteorder = BYTEORDER;
+  header.wordsize = sizeof(unsigned long);
+  header.nentries = sv.count;
+  header.nslots = 16;
+  while(header.nslots < 2 * sv.count) {
+    header.nslots <<= 1;
+  }
+  header.slotsoff = WORDUP(sizeof(header));
+
+  sv.slots = calloc(header.nslots, sizeof(*sv.slots));
+  if(sv.slots == NULL) {
+    return -1;
+  }
+  sv.mask = header.nslots - 1;
+  sv.off = header.slotsoff + header.nslots * sizeof(*sv.slots);
+  (void) hashtable_foreach((hashtable*)d, placeitem, &sv);
+  header.filesize = sv.off;
+
+  /* write it beside the old one and rename it into place, so that */
+  /* anyone with the old one mapped keeps a whole file             */
+  tmppath = malloc(strlen(path) + 5);
+  if(tmppath == NULL) {
+    free(sv.slots);
+    return -1;
+  }
+  strcpy(tmppath, path);
+  strcat(tmppath, ".tmp");
+
+  sv.f = fopen(tmppath, "wb");
+  if(sv.f == NULL) {
+    free(tmppath);
+    free(sv.slots);
+    return -1;
+  }
+
+  err = 0;
+  if((fwrite(&header, sizeof(header), 1, sv.f) != 1) ||
+     (fseek(sv.f, (long)header.slotsoff, SEEK_SET) != 0) ||
+     (fwrite(sv.slots, sizeof(*sv.slots), header.nslots, sv.f)
+      != header.nslots)) {
+    err = -1;
+  }
+
+  /* foreach visits the items in the same order as before */
+  if((err == 0) &&
+     (hashtable_foreach((hashtable*)d, writeitem, &sv) != 0)) {
+    err = -1;
+  }
+
+  if(fclose(sv.f) != 0) {
+    err = -1;
+  }
+  if(err == 0) {
+    err = (rename(tmppath, path) == 0) ? 0 : -1;
+  }
+  if(err != 0) {
+    remove(tmppath);
+  }
+
+  free(tmppath);
+  free(sv.slots);
+  return err;
+}
+
+dictimage *dictimage_open(const char *path)
+{
+  dictimage *img;
+  const dictimage_header *header;
+  struct stat st;
+  void *base;
+  int fd;
+
+  if(path == NULL) {
+    return NULL;
+  }
+
+  fd = open(path, O_RDONLY);
+  if(fd < 0) {
+    return NULL;
+  }
+
+  if((fstat(fd, &st) != 0) ||
+     (st.st_size < (off_t)sizeof(dictimage_header))) {
+    close(fd);
+    return NULL;
+  }
+
+  base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if(base == MAP_FAILED) {
+    return NULL;
+  }
+
+  /* check everything a lookup relies on, once */
+  header = (const dictimage_header*)base;
+  if((memcmp(header->magic, DICTIMAGE_MAGIC, sizeof(header->magic)) != 0) ||
+     (header->byteorder != BYTEORDER) ||
+     (header->wordsize != sizeof(unsigned long)) ||
+     (header->filesize != (unsigned long)st.st_size) ||
+     (header->nslots == 0) ||
+     ((header->nslots & (header->nslots - 1)) != 0) ||
+     (header->nslots > header->filesize / sizeof(dictimage_slot)) ||
+     (header->slotsoff > header->filesize
+      - header->nslots * sizeof(dictimage_slot))) {
+    munmap(base, (size_t)st.st_size);
+    return NULL;
+  }
+
+  img = malloc(sizeof(*img));
+  if(img == NULL) {
+    munmap(base, (size_t)st.st_size);
+    return NULL;
+  }
+
+  img->base = (const char*)base;
+  img->size = (unsigned long)st.st_size;
+  img->header = header;
+  img->slots = (const dictimage_slot*)(img->base + header->slotsoff);
+
+  return img;
+}
+
+void dictimage_close(dictimage *img)
+{
+  if(img == NULL) {
+    return;
+  }
+
+  munmap((void*)img->base, img->size);
+  free(img);
+}
+
+const char *dictimage_get(dictimage *img, const char *key)
+{
+  if(key == NULL) {
+    return NULL;
+  }
+
+  return dictimage_get_n(img, key, strlen(key), NULL);
+}
+
+const char *dictimage_get_n(dictimage *img, const char *key, size_t klen,
+			    size_t *vlen)
+{
+  const dictimage_record *rec;
+  const char *rkey;
+  unsigned long h, hv, mask, n;
+
+  if((img == NULL) ||
+     (key == NULL)) {
+    return NULL;
+  }
+
+  hv = DICTIONARY_HASH(key, klen);
+  mask = img->header->nslots - 1;
+
+  h = hshmix(hv) & mask;
+  for(n = 0; n <= mask; n++) {
+    if(img->slots[h].off == 0) {
+      return NULL;
+    }
+
+    if(img->slots[h].hval == hv) {
+      rec = record(img, img->slots[h].off);
+      if(rec == NULL) {
+	/* damaged image */
+	return NULL;
+      }
+      rkey = (const char*)(rec + 1);
+      if((rec->klen == klen) &&
+	 (memcmp(rkey, key, klen) == 0)) {
+	if(vlen != NULL) {
+	  *vlen = rec->vlen;
+	}
+	return rkey + klen + 1;
+      }
+    }
+
+    h = (h + 1) & mask;
+  }
+
+  return NULL;
+}
+
+unsigned long dictimage_count(dictimage *img)
+{
+  if(img == NULL) {
+    return 0;
+  }
+
+  return img->header->nentries;
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+static int countitem(void *item, void *datum)
+{
+  ((saver*)datum)->count++;
+  return 0;
+}
+
+/* Give item a slot and the next record offset */
+static int placeitem(void *item, void *datum)
+{
+  dictionary_item *di;
+  saver *sv;
+  unsigned long h, hv;
+
+  di = (dictionary_item*)item;
+  sv = (saver*)datum;
+
+  hv = di->hval;
+  for(h = hshmix(hv) & sv->mask;
+      sv->slots[h].off != 0;
+      h = (h + 1) & sv->mask) {
+    /* empty */
+  }
+
+  sv->slots[h].hval = hv;
+  sv->slots[h].off = sv->off;
+  sv->off += RECSIZE(di->klen, di->vlen);
+
+  return 0;
+}
+
+/* Write item's record, where placeitem said it would go */
+static int writeitem(void *item, void *datum)
+{
+  static const char pad[sizeof(unsigned long)] = {0};
+  dictionary_item *di;
+  dictimage_record rec;
+  unsigned long used;
+  saver *sv;
+
+  di = (dictionary_item*)item;
+  sv = (saver*)datum;
+
+  rec.klen = di->klen;
+  rec.vlen = di->vlen;
+  used = sizeof(rec) + rec.klen + 1 + rec.vlen + 1;
+
+  if((fwrite(&rec, sizeof(rec), 1, sv->f) != 1) ||
+     (fwrite(di->key, 1, rec.klen + 1, sv->f) != rec.klen + 1) ||
+     (fwrite(di->value, 1, rec.vlen + 1, sv->f) != rec.vlen + 1) ||
+     (fwrite(pad, 1, RECSIZE(rec.klen, rec.vlen) - used, sv->f)
+      != RECSIZE(rec.klen, rec.vlen) - used)) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/* The record at off, if the whole of it lies inside the image */
+static const dictimage_record *record(dictimage *img, unsigned long off)
+{
+  const dictimage_record *rec;
+
+  if((off > img->size) ||
+     (img->size - off < sizeof(dictimage_record))) {
+    return NULL;
+  }
+
+  rec = (const dictimage_record*)(img->base + off);
+  if((rec->klen > img->size) ||
+     (rec->vlen > img->size) ||
+     (img->size - off - sizeof(dictimage_record)
+      < rec->klen + 1 + rec->vlen + 1)) {
+    return NULL;
+  }
+
+  return rec;
+}
@@ -0,0 +1,127 @@
+/**
+ * @file   dictimage.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 16:08:55 2026
+ *
+ * @brief A read-only, memory-mapped image of a dictionary. An image
+ * is written once with dictionary_save, and dictimage_open maps it
+ * straight back in: lookups run against the mapped file with nothing
+ * to rebuild, and every process mapping the same file shares its
+ * pages.
+ *
+ *
+ */
+
+#ifndef _DICTIMAGE_H_
+#define _DICTIMAGE_H_
+
+#include <stdlib.h>
+
+#include "dictionary.h"
+
+/* The file is a header, a power of 2 array of slots, and then the   */
+/* records.  Everything refers to everything else by byte offset     */
+/* from the start of the file, so the image works wherever it is     */
+/* mapped.  Slots are probed linearly from the key's DICTIONARY_HASH */
+/* put through hshmix.                                               */
+/* Words are native unsigned longs, so an image is only opened on a  */
+/* machine with the same word size and byte order as the writer.     */
+
+#define DICTIMAGE_MAGIC "DICTIMG2"
+
+typedef struct dictimage_header_s dictimage_header;
+struct dictimage_header_s {
+  char magic[8];               /* DICTIMAGE_MAGIC, no terminator */
+  unsigned long byteorder;     /* 0x01020304 as the writer saw it */
+  unsigned long wordsize;      /* sizeof(unsigned long) */
+  unsigned long filesize;
+  unsigned long nentries;
+  unsigned long nslots;        /* a power of 2 */
+  unsigned long slotsoff;      /* offset of the slot array */
+};
+
+/* offset 0 marks an empty slot */
+typedef struct dictimage_slot_s dictimage_slot;
+struct dictimage_slot_s {
+  unsigned long hval;          /* DICTIONARY_HASH of the key */
+  unsigned long off;           /* offset of the record */
+};
+
+/* A record is this, then the key and the value, each followed by */
+/* a '\0', padded out to a multiple of the word size              */
+typedef struct dictimage_record_s dictimage_record;
+struct dictimage_record_s {
+  unsigned long klen;
+  unsigned long vlen;
+};
+
+typedef struct dictimage_s dictimage;
+struct dictimage_s {
+  const char *base;            /* the mapping */
+  unsigned long size;
+  const dictimage_header *header;
+  const dictimage_slot *slots;
+};
+
+/**
+ * Writes an image of a dictionary to a file
+ *
+ * @param d the dictionary
+ * @param path the file to write, replaced if it exists
+ *
+ * @return 0 on success, other on failure
+ */
+int dictionary_save(dictionary *d, const char *path);
+
+/**
+ * Maps an image written by dictionary_save
+ *
+ * @param path the file
+ *
+ * @return the image, or NULL if it could not be mapped or is not a
+ *         usable image
+ */
+dictimage *dictimage_open(const char *path);
+
+/**
+ * Unmaps an image. Strings got from it must not be used afterwards.
+ * Will accept NULL gracefully
+ *
+ * @param img the image
+ */
+void dictimage_close(dictimage *img);
+
+/**
+ * Looks a key up in an image
+ *
+ * @param img the image
+ * @param key the key
+ *
+ * @return the value, pointing into the mapping, or NULL if not found
+ */
+const char *dictimage_get(dictimage *img, const char *key);
+
+/**
+ * Looks a key of klen bytes up in an image, like dictionary_get_n,
+ * so keys holding '\0' can be found
+ *
+ * @param img the image
+ * @param key the key
+ * @param klen the length of the key
+ * @param vlen if not NULL, set to the length of the value found
+ *
+ * @return the value, pointing into the mapping, or NULL if not found
+ */
+const char *dictimage_get_n(dictimage *img, const char *key, size_t klen,
+			    size_t *vlen);
+
+/**
+ * The number of entries in an image
+ *
+ * @param img the image
+ *
+ * @return the number of entries
+ */
+unsigned long dictimage_count(dictimage *img);
+
+#endif /* _DICTIMAGE_H_ */
@@ -4,44 +4,90 @@
  * Private functions
  * 
  */
-static unsigned long di_hash(void *di);
-static unsigned long di_rehash(void *di);
+static unsigned long di_hash2(void *di, unsigned long *rehash);
 static int di_cmp(void *a, void *b);
 static void *di_dup(void *di);
+static void *di_update(void *stored, void *di);
+static dictionary_item *di_make(dictionary_item *s, size_t vcap);
 static void di_free(void *di);
+static void di_probe(dictionary_item *di, const char *key, size_t klen);
 
 
 dictionary *dictionary_new()
 {
-  return (dictionary*)hashtable_new(di_hash, di_rehash, di_cmp, di_dup, di_free);
+  /* both hashes are kept in the item, so neither costs a pass */
+  return (dictionary*)hashtable_new_dual(di_hash2, di_cmp, di_dup, di_free, 0);
 }
 
-char *dictionary_set(dictionary *d, char *key, char *value)
+char *dictionary_set(dictionary *d, const char *key, const char *value)
 {
-  dictionary_item di;
-  
-  di.key = key;
-  di.value = value;
+  return dictionary_set_n(d, key, strlen(key), value, strlen(value));
+}
+
+char *dictionary_upsert(dictionary *d, const char *key, const char *value)
+{
+  return dictionary_upsert_n(d, key, strlen(key), value, strlen(value));
+}
 
-  return (char*)hashtable_insert( (hashtable*)d, (void*)&di);
+char *dictionary_get(dictionary *d, const char *key)
+{
+  return dictionary_get_n(d, key, strlen(key), NULL);
 }
 
-char *dictionary_get(dictionary *d, char *key)
+void dictionary_remove(dictionary *d, const char *key)
 {
-  dictionary_item di;
+  dictionary_remove_n(d, key, strlen(key));
+}
+
+char *dictionary_set_n(dictionary *d, const char *key, size_t klen,
+		       const char *value, size_t vlen)
+{
+  dictionary_item di, *stored;
+
+  di_probe(&di, key, klen);
+  di.value = (char*)value;
+  di.vlen = vlen;
+
+  stored = hashtable_insert( (hashtable*)d, (void*)&di);
+  return (stored == NULL) ? NULL : stored->value;
+}
+
+char *dictionary_upsert_n(dictionary *d, const char *key, size_t klen,
+			  const char *value, size_t vlen)
+{
+  dictionary_item di, *stored;
 
-  di.key = key;
-  di.value = NULL;
+  di_probe(&di, key, klen);
+  di.value = (char*)value;
+  di.vlen = vlen;
 
-  return (char*)hashtable_find( (hashtable*)d, (void*)&di );
+  stored = hashtable_upsert( (hashtable*)d, (void*)&di, di_update);
+  return (stored == NULL) ? NULL : stored->value;
 }
 
-void dictionary_remove(dictionary *d, char *key)
+char *dictionary_get_n(dictionary *d, const char *key, size_t klen,
+		       size_t *vlen)
+{
+  dictionary_item di, *found;
+
+  di_probe(&di, key, klen);
+
+  found = hashtable_find( (hashtable*)d, (void*)&di );
+  if(found == NULL) {
+    return NULL;
+  }
+
+  if(vlen != NULL) {
+    *vlen = found->vlen;
+  }
+  return found->value;
+}
+
+void dictionary_remove_n(dictionary *d, const char *key, size_t klen)
 {
   dictionary_item di;
   
-  di.key = key;
-  di.value = NULL;
+  di_probe(&di, key, klen);
   
   di_free( hashtable_remove( (hashtable*)d, (void*)&di) );
 }
@@ -57,47 +103,111 @@ void dictionary_free(dictionary *d)
  * 
  */
 
-static unsigned long di_hash(void *di)
+static unsigned long di_hash2(void *di, unsigned long *rehash)
 {
-  return hash_string( ((dictionary_item*)di)->key );
+  *rehash = ((dictionary_item*)di)->rval;
+  return ((dictionary_item*)di)->hval;
+}
+
+/* the hashtable only asks whether two items are equal */
+static int di_cmp(void *a, void *b)
+{
+  dictionary_item *l, *r;
+
+  l = (dictionary_item*)a;
+  r = (dictionary_item*)b;
+
+  if((l->hval != r->hval) ||
+     (l->klen != r->klen)) {
+    return 1;
+  }
+
+  return memcmp(l->key, r->key, l->klen);
 }
 
-static unsigned long di_rehash(void *di)
+static void *di_dup(void *di)
 {
-  return rehash_string( ((dictionary_item*)di)->key );
+  if(di == NULL) {
+    return NULL;
+  }
+
+  return (void*)di_make((dictionary_item*)di, ((dictionary_item*)di)->vlen);
 }
 
-static int di_cmp(void *a, void *b)
+/* Overwrite the stored value if the new one fits, else */
+/* replace the item with one that has room to spare     */
+static void *di_update(void *stored, void *di)
 {
-  return strcmp( ((dictionary_item*)a)->key, ((dictionary_item*)b)->key );
+  dictionary_item *s, *n, *d;
+  size_t vcap;
+
+  s = (dictionary_item*)stored;
+  n = (dictionary_item*)di;
+
+  if(n->vlen <= s->vcap) {
+    memcpy(s->value, n->value, n->vlen);
+    s->value[n->vlen] = '\0';
+    s->vlen = n->vlen;
+    return stored;
+  }
+
+  /* a value that has outgrown its room once will likely again, */
+  /* but half as much again must not wrap round                  */
+  vcap = n->vlen;
+  if(vcap <= ((size_t)-1) / 3 * 2) {
+    vcap += vcap / 2;
+  }
+
+  d = di_make(n, vcap);
+  if(d == NULL) {
+    return NULL;
+  }
+
+  di_free(stored);
+  return (void*)d;
 }
 
-static void *di_dup(void *di)
+/* A stored copy of s, with room for a value of vcap bytes */
+static dictionary_item *di_make(dictionary_item *s, size_t vcap)
 {
   dictionary_item *d;
 
-  if(di == NULL) {
+  if(vcap > ((size_t)-1) - sizeof(*d) - s->klen - 2) {
     return NULL;
   }
 
-  d = calloc(1, sizeof(dictionary_item));
+  d = malloc(sizeof(*d) + s->klen + 1 + vcap + 1);
   if(d == NULL) {
     return NULL;
   }
 
-  d->key = strdup( ((dictionary_item*)di)->key );
-  d->value = strdup( ((dictionary_item*)di)->value );
-
-  return (void*)d;
+  d->key = (char*)(d + 1);
+  d->value = d->key + s->klen + 1;
+  d->hval = s->hval;
+  d->rval = s->rval;
+  d->klen = s->klen;
+  d->vlen = s->vlen;
+  d->vcap = vcap;
+  memcpy(d->key, s->key, s->klen);
+  d->key[s->klen] = '\0';
+  memcpy(d->value, s->value, s->vlen);
+  d->value[s->vlen] = '\0';
+
+  return d;
 }
 
 static void di_free(void *di)
 {
-  if(di == NULL) {
-    return;
-  }
-  
-  free( ((dictionary_item*)di)->key );
-  free( ((dictionary_item*)di)->value );
   free(di);
 }
+
+/* Fill in the key half of an item to look for */
+static void di_probe(dictionary_item *di, const char *key, size_t klen)
+{
+  di->key = (char*)key;
+  di->value = NULL;
+  di->hval = DICTIONARY_HASH2(key, klen, &di->rval);
+  di->klen = klen;
+  di->vlen = 0;
+  di->vcap = 0;
+}
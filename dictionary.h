@@ -19,20 +19,136 @@
 
 typedef hashtable dictionary;
 
+/* A stored item is one allocation: this struct, then the key and   */
+/* the value, each followed by a '\0'.  key and value point into it. */
+/* The hash and lengths are kept so that comparing two items only    */
+/* gets as far as the strings when those already match.  vcap bytes  */
+/* are left for the value, so dictionary_upsert can overwrite it in  */
+/* place with anything no longer.                                    */
 typedef struct dictionary_item_s dictionary_item;
 struct dictionary_item_s {
   char *key;
   char *value;
+  unsigned long hval;          /* DICTIONARY_HASH(key, klen) */
+  unsigned long rval;          /* the rehash, so probing never rehashes */
+  size_t klen;                 /* length of key */
+  size_t vlen;                 /* length of value */
+  size_t vcap;                 /* room for the value, less the '\0' */
 };
 
+/* The hash of a key of klen bytes, as kept in hval, and the same */
+/* from the one pass that also puts the rehash in *rv, for rval    */
+#define DICTIONARY_HASH(key, klen)				\
+  ((unsigned long)hash_string64_n((key), (klen)))
+#define DICTIONARY_HASH2(key, klen, rv)				\
+  hash_string_dual_n((key), (klen), (rv))
+
 
 dictionary *dictionary_new();
 
-char *dictionary_set(dictionary *d, char *key, char *value);
+/* Stored values do not move when the table is reorganized: a     */
+/* pointer returned by the functions below stays good until its    */
+/* key is removed, its value is replaced by dictionary_upsert, or  */
+/* the dictionary is freed.                                        */
+
+/** 
+ * Sets a key to a value, unless the key is there already
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param value the value
+ * 
+ * @return the stored value, which is the old one if the key was
+ *         there already, or NULL on failure
+ */
+char *dictionary_set(dictionary *d, const char *key, const char *value);
 
-char *dictionary_get(dictionary *d, char *key);
+/** 
+ * Looks up a key
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * 
+ * @return the stored value, or NULL if not found
+ */
+char *dictionary_get(dictionary *d, const char *key);
+
+/** 
+ * Removes a key, if it is there
+ * 
+ * @param d the dictionary
+ * @param key the key
+ */
+void dictionary_remove(dictionary *d, const char *key);
+
+/** 
+ * Sets a key to a value, replacing any value it had. The key is
+ * looked up once, and a value that fits in the old one's room is
+ * copied over it. Pointers got earlier for this key's value must not
+ * be used afterwards
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param value the value
+ * 
+ * @return the stored value, or NULL on failure
+ */
+char *dictionary_upsert(dictionary *d, const char *key, const char *value);
 
-void dictionary_remove(dictionary *d, char *key);
+/** 
+ * Sets a key to a value, like dictionary_set, but with the lengths
+ * given, so either may hold any bytes, '\0' included. The stored
+ * copies still get a '\0' after them
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ * @param value the value
+ * @param vlen the length of the value
+ * 
+ * @return the stored value, or NULL on failure
+ */
+char *dictionary_set_n(dictionary *d, const char *key, size_t klen,
+		       const char *value, size_t vlen);
+
+/** 
+ * Sets a key to a value, like dictionary_upsert, but with the
+ * lengths given
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ * @param value the value
+ * @param vlen the length of the value
+ * 
+ * @return the stored value, or NULL on failure
+ */
+char *dictionary_upsert_n(dictionary *d, const char *key, size_t klen,
+			  const char *value, size_t vlen);
+
+/** 
+ * Looks up a key of klen bytes. The key need not be terminated, so
+ * it can be a slice of a larger buffer, and nothing is copied or
+ * allocated
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ * @param vlen if not NULL, set to the length of the value found
+ * 
+ * @return the stored value, or NULL if not found
+ */
+char *dictionary_get_n(dictionary *d, const char *key, size_t klen,
+		       size_t *vlen);
+
+/** 
+ * Removes a key of klen bytes, if it is there
+ * 
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ */
+void dictionary_remove_n(dictionary *d, const char *key, size_t klen);
 
 void dictionary_free(dictionary *d);
 
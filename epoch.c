@@ -0,0 +1,236 @@
+/**
+ * @file   epoch.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 10:40:17 2026
+ *
+ * @brief  Epoch based memory reclamation. More documentation in
+ * epoch.h
+ *
+ *
+ */
+
+#include "epoch.h"
+
+/**
+ * Private functions
+ *
+ */
+static int tryadvance(epoch *e);
+
+/* The epoch kept in a thread state drops the top bit, so */
+/* compare epochs through this                            */
+#define EPOCHBITS(g) ((g) & (((unsigned long)-1) >> 1))
+
+
+epoch *epoch_new(void)
+{
+  epoch *e;
+
+  e = calloc(1, sizeof(*e));
+  if(e == NULL) {
+    return NULL;
+  }
+
+  if(pthread_mutex_init(&e->lock, NULL) != 0) {
+    free(e);
+    return NULL;
+  }
+
+  e->global = 0;
+  e->threads = NULL;
+  e->limbo = NULL;
+
+  return e;
+}
+
+void epoch_free(epoch *e)
+{
+  epoch_thread *t, *tnext;
+  epoch_limbo *l, *lnext;
+
+  if(e == NULL) {
+    return;
+  }
+
+  for(l = e->limbo; l != NULL; l = lnext) {
+    lnext = l->next;
+    l->freefn(l->ptr);
+    free(l);
+  }
+
+  for(t = e->threads; t != NULL; t = tnext) {
+    tnext = t->next;
+    free(t);
+  }
+
+  pthread_mutex_destroy(&e->lock);
+  free(e);
+}
+
+epoch_thread *epoch_register(epoch *e)
+{
+  epoch_thread *t;
+
+  if(e == NULL) {
+    return NULL;
+  }
+
+  /* reuse a record given up by some other thread */
+  for(t = __atomic_load_n(&e->threads, __ATOMIC_ACQUIRE);
+      t != NULL;
+      t = t->next) {
+    if(__sync_bool_compare_and_swap(&t->inuse, 0, 1)) {
+      return t;
+    }
+  }
+
+  t = calloc(1, sizeof(*t));
+  if(t == NULL) {
+    return NULL;
+  }
+  t->state = 0;
+  t->inuse = 1;
+
+  /* records are only ever pushed, so readers of the list need no lock */
+  do {
+    t->next = __atomic_load_n(&e->threads, __ATOMIC_ACQUIRE);
+  } while(!__sync_bool_compare_and_swap(&e->threads, t->next, t));
+
+  return t;
+}
+
+void epoch_unregister(epoch_thread *t)
+{
+  if(t == NULL) {
+    return;
+  }
+
+  __atomic_store_n(&t->state, 0UL, __ATOMIC_RELEASE);
+  __atomic_store_n(&t->inuse, 0, __ATOMIC_RELEASE);
+}
+
+void epoch_enter(epoch *e, epoch_thread *t)
+{
+  unsigned long g;
+
+  g = __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+  __atomic_store_n(&t->state, (g << 1) | 1, __ATOMIC_RELAXED);
+
+  /* our state must be visible before we load any shared pointer */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+void epoch_exit(epoch_thread *t)
+{
+  __atomic_store_n(&t->state, 0UL, __ATOMIC_RELEASE);
+}
+
+void epoch_retire(epoch *e, void *ptr, epoch_freefn freefn)
+{
+  epoch_limbo *l;
+
+  if((e == NULL) ||
+     (ptr == NULL) ||
+     (freefn == NULL)) {
+    return;
+  }
+
+  l = malloc(sizeof(*l));
+  if(l == NULL) {
+    /* nowhere to queue it, so wait it out here */
+    epoch_synchronize(e);
+    freefn(ptr);
+    return;
+  }
+
+  l->ptr = ptr;
+  l->freefn = freefn;
+
+  pthread_mutex_lock(&e->lock);
+  l->epoch = __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+  l->next = e->limbo;
+  e->limbo = l;
+  pthread_mutex_unlock(&e->lock);
+}
+
+void epoch_reclaim(epoch *e)
+{
+  epoch_limbo *l, *prev, *next;
+  unsigned long g;
+
+  if(e == NULL) {
+    return;
+  }
+
+  (void) tryadvance(e);
+
+  pthread_mutex_lock(&e->lock);
+  g = __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+
+  /* the list is newest first, so everything past the first entry */
+  /* that is two epochs old is at least as old                    */
+  prev = NULL;
+  for(l = e->limbo; l != NULL; prev = l, l = l->next) {
+    if(g - l->epoch >= 2) {
+      break;
+    }
+  }
+  if(prev == NULL) {
+    e->limbo = NULL;
+  } else {
+    prev->next = NULL;
+  }
+  pthread_mutex_unlock(&e->lock);
+
+  for(; l != NULL; l = next) {
+    next = l->next;
+    l->freefn(l->ptr);
+    free(l);
+  }
+}
+
+void epoch_synchronize(epoch *e)
+{
+  unsigned long start;
+
+  if(e == NULL) {
+    return;
+  }
+
+  start = __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+  while(__atomic_load_n(&e->global, __ATOMIC_ACQUIRE) - start < 2) {
+    (void) tryadvance(e);
+  }
+
+  epoch_reclaim(e);
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* Move the global epoch on by one, if every thread inside the */
+/* domain has seen the current one.  Returns 1 if it moved.    */
+static int tryadvance(epoch *e)
+{
+  epoch_thread *t;
+  unsigned long g, state;
+
+  /* retirements before this must be ordered before the scan */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  g = __atomic_load_n(&e->global, __ATOMIC_ACQUIRE);
+  for(t = __atomic_load_n(&e->threads, __ATOMIC_ACQUIRE);
+      t != NULL;
+      t = t->next) {
+    state = __atomic_load_n(&t->state, __ATOMIC_ACQUIRE);
+    if((state & 1) &&
+       ((state >> 1) != EPOCHBITS(g))) {
+      return 0;
+    }
+  }
+
+  return __sync_bool_compare_and_swap(&e->global, g, g + 1);
+}
@@ -0,0 +1,134 @@
+/**
+ * @file   epoch.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 10:12:41 2026
+ *
+ * @brief Epoch based memory reclamation. Lets readers on many
+ * threads follow pointers into a shared structure without locks,
+ * while writers unlink and retire memory that is only freed once no
+ * reader can still be looking at it.
+ *
+ *
+ */
+
+#ifndef _EPOCH_H_
+#define _EPOCH_H_
+
+#include <stdlib.h>
+#include <pthread.h>
+
+/* Readers bracket every access with epoch_enter() and epoch_exit(),  */
+/* both of which are wait-free.  A pointer loaded inside the bracket  */
+/* stays valid until epoch_exit().  Writers hand memory they have     */
+/* unlinked to epoch_retire(), and it is freed two global epochs      */
+/* later, by which time every reader that could have seen it is gone. */
+
+/* frees a retired pointer */
+typedef void (*epoch_freefn)(void *ptr);
+
+/* one per thread using a domain, from epoch_register() */
+typedef struct epoch_thread_s epoch_thread;
+struct epoch_thread_s {
+  unsigned long state;   /* (epoch << 1) | 1 while inside, else 0 */
+  int inuse;             /* claimed by a thread */
+  epoch_thread *next;
+};
+
+/* memory waiting for its grace period to pass */
+typedef struct epoch_limbo_s epoch_limbo;
+struct epoch_limbo_s {
+  void *ptr;
+  epoch_freefn freefn;
+  unsigned long epoch;   /* global epoch when it was retired */
+  epoch_limbo *next;
+};
+
+typedef struct epoch_s epoch;
+struct epoch_s {
+  unsigned long global;    /* the global epoch */
+  epoch_thread *threads;   /* every record ever registered */
+  epoch_limbo *limbo;      /* retired, newest first */
+  pthread_mutex_t lock;    /* guards limbo */
+};
+
+/**
+ * Creates a new reclamation domain
+ *
+ * @return the domain, or NULL on failure
+ */
+epoch *epoch_new(void);
+
+/**
+ * Frees a domain, and everything still waiting in it. No thread may
+ * be inside the domain. Will accept NULL gracefully
+ *
+ * @param e the domain
+ */
+void epoch_free(epoch *e);
+
+/**
+ * Registers the calling thread with a domain. Records of threads
+ * that have unregistered are reused
+ *
+ * @param e the domain
+ *
+ * @return the thread's record, or NULL on failure
+ */
+epoch_thread *epoch_register(epoch *e);
+
+/**
+ * Gives up a record from epoch_register. The thread must not be
+ * inside the domain
+ *
+ * @param t the record
+ */
+void epoch_unregister(epoch_thread *t);
+
+/**
+ * Enters a read side critical section. Sections do not nest
+ *
+ * @param e the domain
+ * @param t the calling thread's record
+ */
+void epoch_enter(epoch *e, epoch_thread *t);
+
+/**
+ * Leaves a read side critical section. Pointers loaded inside it
+ * must not be used afterwards
+ *
+ * @param t the calling thread's record
+ */
+void epoch_exit(epoch_thread *t);
+
+/**
+ * Hands ptr over to be freed with freefn once no reader can still
+ * hold it. ptr must already be unreachable for new readers. If no
+ * memory is left to queue it, this waits out a grace period and
+ * frees ptr itself, so it must not be called from inside a
+ * critical section
+ *
+ * @param e the domain
+ * @param ptr the memory to free
+ * @param freefn how to free it
+ */
+void epoch_retire(epoch *e, void *ptr, epoch_freefn freefn);
+
+/**
+ * Advances the global epoch if every reader has caught up with it,
+ * and frees whatever retired memory has become safe. Writers should
+ * call this now and then; it never blocks on readers
+ *
+ * @param e the domain
+ */
+void epoch_reclaim(epoch *e);
+
+/**
+ * Waits until every reader that was inside the domain when this was
+ * called has left, then frees everything retired before the call.
+ * Must not be called from inside a critical section
+ *
+ * @param e the domain
+ */
+void epoch_synchronize(epoch *e);
+
+#endif /* _EPOCH_H_ */
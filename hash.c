@@ -1,6 +1,8 @@
 #include "hash.h"
+#include <stdlib.h>
+#include <string.h>
 
-unsigned long lhash_string(const char *string)
+unsigned long hash_string(const char *string)
 {
   /* This is an implementation of sdbm string hashing */  
   unsigned long hash = 0;
@@ -10,7 +12,7 @@ unsigned long lhash_string(const char *string)
   return hash;
 }
 
-unsigned long lrehash_string(const char *string)
+unsigned long rehash_string(const char *string)
 {
   /* this is an implementation of rs string hashing */
   unsigned long hash = 0;
@@ -25,35 +27,296 @@ unsigned long lrehash_string(const char *string)
   return hash;
 }
 
-unsigned long long llhash_general(void *data, unsigned int length)
+unsigned long hash_string_n(const char *string, size_t len)
 {
-  static unsigned long long hash_tab[256] = {0};
-  static unsigned long long h;
-  char *k;
-  int i;
-  int j;
-
-  /* init the hash table on the first run */
-  if(!hash_tab[0]) {
-    h = 0x544B2FBACAAF1684LL;
-    
-    for (j = 0; j < 256; j++) {
-      for (i = 0; i < 31; i++) {
-	h = (h >> 7) ^ h;
-	h = (h << 11) ^ h;
-	h = (h >> 10) ^ h;
-      }
-      hash_tab[j] = h;
+  unsigned long hash = 0;
+  while(len--) {
+    hash = *string++ + ( hash << 6 ) + ( hash << 16 ) - hash; 
+  }
+  return hash;
+}
+
+unsigned long rehash_string_n(const char *string, size_t len)
+{
+  unsigned long hash = 0;
+  unsigned long a = 63689;
+  unsigned long b = 378551;
+
+  while(len--) {
+    hash = hash*a + *string++;
+    a *= b;
+  }  
+ 
+  return hash;
+}
+
+/* wyhash (Wang Yi's, final version 4), read a word at a time.  Words */
+/* are put together from little-endian bytes, so a hash is the same on */
+/* every machine.                                                      */
+#define WY_S0 0x2d358dccaa6c78a5ULL
+#define WY_S1 0x8bb84b93962eacc9ULL
+#define WY_S2 0x4b33a62ed433d4a3ULL
+#define WY_S3 0x4d5a2da51de1aa47ULL
+
+/* the seed rehash_string64 starts from, so it is unrelated to hash_string64 */
+#define WY_RESEED 0x9e3779b97f4a7c15ULL
+
+static unsigned long long wyr8(const unsigned char *p)
+{
+  return ((unsigned long long)p[0]) | ((unsigned long long)p[1] << 8) |
+    ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24) |
+    ((unsigned long long)p[4] << 32) | ((unsigned long long)p[5] << 40) |
+    ((unsigned long long)p[6] << 48) | ((unsigned long long)p[7] << 56);
+}
+
+static unsigned long long wyr4(const unsigned char *p)
+{
+  return ((unsigned long long)p[0]) | ((unsigned long long)p[1] << 8) |
+    ((unsigned long long)p[2] << 16) | ((unsigned long long)p[3] << 24);
+}
+
+/* 1 to 3 bytes */
+static unsigned long long wyr3(const unsigned char *p, size_t k)
+{
+  return ((unsigned long long)p[0] << 16) |
+    ((unsigned long long)p[k >> 1] << 8) | p[k - 1];
+}
+
+/* the 128 bit product of a and b, low half in a and high half in b */
+static void wymum(unsigned long long *a, unsigned long long *b)
+{
+#ifdef __SIZEOF_INT128__
+  __extension__ unsigned __int128 r;
+
+  r = *a;
+  r *= *b;
+  *a = (unsigned long long)r;
+  *b = (unsigned long long)(r >> 64);
+#else
+  unsigned long long ha, hb, la, lb, rh, rm0, rm1, rl, t, lo, c;
+
+  ha = *a >> 32;
+  hb = *b >> 32;
+  la = *a & 0xffffffffULL;
+  lb = *b & 0xffffffffULL;
+
+  rh = ha * hb;
+  rm0 = ha * lb;
+  rm1 = hb * la;
+  rl = la * lb;
+
+  t = rl + (rm0 << 32);
+  c = (t < rl);
+  lo = t + (rm1 << 32);
+  c += (lo < t);
+
+  *a = lo;
+  *b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+}
+
+static unsigned long long wymix(unsigned long long a, unsigned long long b)
+{
+  wymum(&a, &b);
+  return a ^ b;
+}
+
+/* The wyhash of len bytes at key.  If second is not NULL a second */
+/* hash, from the same 128 bits mixed the other way, goes in it.    */
+static unsigned long long wyhash(const char *key, size_t len,
+				 unsigned long long seed,
+				 unsigned long long *second)
+{
+  const unsigned char *p;
+  unsigned long long a, b, see1, see2;
+  size_t i;
+
+  p = (const unsigned char*)key;
+  seed ^= wymix(seed ^ WY_S0, WY_S1);
+
+  if(len <= 16) {
+    if(len >= 4) {
+      a = (wyr4(p) << 32) | wyr4(p + ((len >> 3) << 2));
+      b = (wyr4(p + len - 4) << 32) | wyr4(p + len - 4 - ((len >> 3) << 2));
+    } else if(len > 0) {
+      a = wyr3(p, len);
+      b = 0;
+    } else {
+      a = b = 0;
+    }
+  } else {
+    i = len;
+    if(i > 48) {
+      see1 = seed;
+      see2 = seed;
+      do {
+	seed = wymix(wyr8(p) ^ WY_S1, wyr8(p + 8) ^ seed);
+	see1 = wymix(wyr8(p + 16) ^ WY_S2, wyr8(p + 24) ^ see1);
+	see2 = wymix(wyr8(p + 32) ^ WY_S3, wyr8(p + 40) ^ see2);
+	p += 48;
+	i -= 48;
+      } while(i > 48);
+      seed ^= see1 ^ see2;
     }
+    while(i > 16) {
+      seed = wymix(wyr8(p) ^ WY_S1, wyr8(p + 8) ^ seed);
+      p += 16;
+      i -= 16;
+    }
+    /* the last 16 bytes, overlapping what went before */
+    a = wyr8(p + i - 16);
+    b = wyr8(p + i - 8);
+  }
 
+  a ^= WY_S1;
+  b ^= seed;
+  wymum(&a, &b);
+  if(second != NULL) {
+    *second = wymix(a ^ WY_S2 ^ len, b ^ WY_S3);
   }
+  return wymix(a ^ WY_S0 ^ len, b ^ WY_S1);
+}
+
+unsigned long long hash_string64(const char *string)
+{
+  return wyhash(string, strlen(string), 0, NULL);
+}
+
+unsigned long long rehash_string64(const char *string)
+{
+  return wyhash(string, strlen(string), WY_RESEED, NULL);
+}
+
+unsigned long long hash_string64_n(const char *string, size_t len)
+{
+  return wyhash(string, len, 0, NULL);
+}
+
+unsigned long long rehash_string64_n(const char *string, size_t len)
+{
+  return wyhash(string, len, WY_RESEED, NULL);
+}
+
+unsigned long hash_string_dual(const char *string, unsigned long *rehash)
+{
+  return hash_string_dual_n(string, strlen(string), rehash);
+}
+
+unsigned long hash_string_dual_n(const char *string, size_t len,
+				 unsigned long *rehash)
+{
+  unsigned long long h, r;
+
+  h = wyhash(string, len, 0, &r);
+  *rehash = (unsigned long)r;
+  return (unsigned long)h;
+}
+
+/* llhash_general's byte table: entry j is the xorshift generator */
+/* below, seeded with 0x544B2FBACAAF1684, after 31*(j+1) steps.    */
+/*   h = (h >> 7) ^ h;  h = (h << 11) ^ h;  h = (h >> 10) ^ h;     */
+/* It is a constant so threads share it read-only.                 */
+static const unsigned long long llhash_tab[256] = {
+  0xCFB2B99D0CDB12A6ULL, 0xD219E697E4AD6E46ULL, 0x1F644A1248CF37E7ULL,
+  0xA210B14901DF5F24ULL, 0xED196F2DC5728FF1ULL, 0xFB6E5670674D81F9ULL,
+  0xD041958D2B1961C3ULL, 0x27CCADB8C443CA6FULL, 0x88B2213C5387CD53ULL,
+  0x836C61BC127FB805ULL, 0x3FB8BF26E26B41F0ULL, 0x6BD68797C20D371EULL,
+  0x78042213A30C2F42ULL, 0x6EE1D944F4F7171FULL, 0x6CB617F8F677C688ULL,
+  0xD31658C68562C1E1ULL, 0x4F00AEE953220EC1ULL, 0xB804BFF8314F3FECULL,
+  0xD460B0614FC9CAD9ULL, 0xDE54D682B7B22A54ULL, 0xCC00941D645E8DA3ULL,
+  0x1BBBDE2EB3085850ULL, 0xF6B3974DED5DE71FULL, 0xEEA4524C7B719D1AULL,
+  0x189581DBD8C7503BULL, 0x1A84D3933EC3BD28ULL, 0x052484A789001B3DULL,
+  0xA0BF735D9834F8A8ULL, 0x74435E1EDF242454ULL, 0x4457169A3235C27EULL,
+  0x00A90D1FA1B00A16ULL, 0xC0EB3EA3AF37BF29ULL, 0x7484792CC84B363FULL,
+  0xBA4B053AD113C7B8ULL, 0xC750548A2C551810ULL, 0xD9C1A9E9421EB772ULL,
+  0x28EE6935D96B73C2ULL, 0xBED40D4935F91900ULL, 0xBD7B7DFE3D988252ULL,
+  0x2D72763E82C39A37ULL, 0xF80B50391F9DD50EULL, 0xDFCD9AADB1B1F5ABULL,
+  0x68C4C3E9E7B5D67EULL, 0xA12B81D8522CC634ULL, 0x964FF357F9E526CFULL,
+  0xA705970CA565DCBBULL, 0xF2138DDB3E082CB4ULL, 0xB7286DFC05939779ULL,
+  0x8D8D47E804781E7CULL, 0xEEC68E0F399D758DULL, 0xD4A9A8973D426738ULL,
+  0xE88BED9FB8C5F324ULL, 0x16A4A948E0F11C51ULL, 0x6F2AC7F5F772B396ULL,
+  0x0E069A1A31C67BA7ULL, 0xFB1F4057A626575EULL, 0xEB5CBFBA2116BFAEULL,
+  0x7055D24392268EB7ULL, 0x878D8B50C030510BULL, 0x36BC274E3FA00CA0ULL,
+  0x8FEEFF38B9AD7D30ULL, 0xD4B356445155AFB0ULL, 0x62AD44D49466F1E2ULL,
+  0x6B48343EB71AAFF8ULL, 0xCC2F5756A23DA8F2ULL, 0xB3524157AB4F1FACULL,
+  0xDB06A1D1E53ABD85ULL, 0x8DD4D3A66D29A609ULL, 0xABFDFC3222C126FBULL,
+  0x243F470ED936E6EEULL, 0x84B660AC7222DD43ULL, 0xB42B800EA89D137BULL,
+  0x54DA1E338B88AA89ULL, 0x9D50C9F40972FE94ULL, 0x4C521DD0C45C8A60ULL,
+  0x8E474D5BB76521B5ULL, 0xF73F8A307BCB02DAULL, 0x87BC81FA0D40AC5DULL,
+  0xAB466DD1DBB86044ULL, 0x13EE61BFC7457E50ULL, 0xE32E44013C4BF031ULL,
+  0x52D2B05683A9973FULL, 0x448994D9B359147CULL, 0x8E896FE5CA63AA73ULL,
+  0xE094313B32E6BC8BULL, 0xF498347508DE048DULL, 0xEB48A3A475687A9EULL,
+  0xD0881E907CB83114ULL, 0x78F0CD92AE0016D4ULL, 0xB99BFAF7EE15381BULL,
+  0x5426651C8FA88A2EULL, 0x35B9B97CFF4A123EULL, 0xFEB3F7217E07524EULL,
+  0xA905FF1DE4C3B333ULL, 0xFF53B53F5C813935ULL, 0x0170CB10B2650529ULL,
+  0x8D6454844F4414ECULL, 0x3C91CFC6B88D79F6ULL, 0x719EE4EE42D8FFDEULL,
+  0x46F483CBFA14433BULL, 0xCCB544E57CF412CFULL, 0xF3283F17A42CBD76ULL,
+  0xF906FBC0872E788DULL, 0x7673C6F845C7D309ULL, 0x7A162DBA168BA48BULL,
+  0xA48EF9FDF70BFA7AULL, 0xF299E96F86313A51ULL, 0xA0F5D1347B89405FULL,
+  0x3DFBB3F11C885EAEULL, 0x0E1997DC89E2555FULL, 0x5A3D4357AD9C72FBULL,
+  0x3EC660A5400511D6ULL, 0x425DFCB525DC12C2ULL, 0x133FD596EB34BFDAULL,
+  0x9A5EA3D48F19BD91ULL, 0x743434FABA2DE272ULL, 0x2C9F858527953D3EULL,
+  0x15E96F04060804EFULL, 0xF52C525FA68BCE4AULL, 0xB70470A4E7F12ADFULL,
+  0xEB8304991512324DULL, 0x2A10A9A54525125FULL, 0xA59D1217B917872FULL,
+  0x48B255F7BC6FFFEEULL, 0x027EA74FFD69C29FULL, 0xC681CDB042F1EE24ULL,
+  0xDFB07CF8DBC35B51ULL, 0x4ACF28CEF2B0D394ULL, 0xCF50969176D5E91FULL,
+  0x66B6C2536FD651A5ULL, 0x2C3EAD8DD718DA27ULL, 0x24439557170E124DULL,
+  0xEF340A6126AB4EFFULL, 0xFC5AD2EBE0989C40ULL, 0x920774D2E648D4F3ULL,
+  0x8A05BD64CD017372ULL, 0x1FBCB206F20927EAULL, 0x9ABEBA4FFD46B4DDULL,
+  0xEB1AB036D821CD1DULL, 0x7B0B5D5BD99EA45BULL, 0x300D3DD71950C249ULL,
+  0x94DE34E568F9E0EDULL, 0xE201E50DD163CF9EULL, 0x8120CA397B8F68C7ULL,
+  0x286A759D0210E7F7ULL, 0xE2F07B015CFF4A6BULL, 0x6984596F79F6BB59ULL,
+  0xE213861F88D1F0E2ULL, 0x88B71D894BAE9C0CULL, 0x61AC50F9D69BB5D7ULL,
+  0x4ABE68EF2539F75EULL, 0x2BD7D1580039E29CULL, 0x67619178B848E653ULL,
+  0xB2EFAF9082922680ULL, 0xE50149844E18E0D9ULL, 0x3BC4E082D8900B51ULL,
+  0x1AA93D75BF41BCF5ULL, 0xD715089886DC7F51ULL, 0x6F905377F73BE2CCULL,
+  0xA87B2192A9EC936CULL, 0x53BA079446C59839ULL, 0xEAC642C98EBC6A20ULL,
+  0x7FD79F90B8A64008ULL, 0x544A6392D7E13C3BULL, 0xA3AA0462241C38ADULL,
+  0x2793F11F8DA3E21FULL, 0x2A877D534C91FAD3ULL, 0x8604C4532AAE4A2CULL,
+  0xA3E81AD97B8DB15BULL, 0xE875A49A20AFEF24ULL, 0x6E7F222B7EF24CF6ULL,
+  0x5792ABA577CE3F74ULL, 0x607DDCBA1BAE8558ULL, 0xEE8ACB12630D756DULL,
+  0xD32C08EF305A872EULL, 0x0677BF3669F0CF2AULL, 0x833B51AE3F00F081ULL,
+  0x30BCB7F6B08BE66AULL, 0xF6A869545A0995A5ULL, 0x8B97EE346014CB7FULL,
+  0x5083F34F30B70146ULL, 0xF5607DA4A039EF3FULL, 0x1FEA8077E88F79F4ULL,
+  0xC8BCBDD51BC720B2ULL, 0x740FF049AB80EF12ULL, 0xFC0BF2DD811FA033ULL,
+  0xF65878ADAD03CAC7ULL, 0x128E2E45E9400CB6ULL, 0x1AC406F752140D66ULL,
+  0x2A0581E3F3BE3EB9ULL, 0x01DD7392FF4751C0ULL, 0x47DD1C4ACB359993ULL,
+  0x043C49FF776D772EULL, 0xE56781679B3A0A42ULL, 0xCDA428664F5FE70BULL,
+  0x46EF3F59B8F5B16BULL, 0x96D8293E857C14E4ULL, 0x2E5D55597574612AULL,
+  0x82AB167782F255C3ULL, 0x740202F604709C0EULL, 0x69DEC2755C24819DULL,
+  0x0FA4C4E4529A85C3ULL, 0xA842CE671F6B3CC6ULL, 0x534FF306FC3F3921ULL,
+  0xD5EBD1D0E409409AULL, 0xE5D832762CD50129ULL, 0xAFA9ADE61B7B5588ULL,
+  0x279EC19A2E6170E3ULL, 0x98EA301188D4767AULL, 0x76FBCC3F6DDEE660ULL,
+  0x50A186F64B6EB4ADULL, 0x97A40B15F3B6F53DULL, 0x1E316573CFFF42A5ULL,
+  0x0DB9AD31A48DEC1DULL, 0x6112372F4F93E2D5ULL, 0x34410EE5CCC47340ULL,
+  0x624164F7E8592979ULL, 0xD34111C5DC2FC9FEULL, 0xA54840CEB2350293ULL,
+  0x986A003A6C48FB33ULL, 0x0C1D0A3F47D2910CULL, 0x42C8C760AF2EC590ULL,
+  0x955420E8DB435554ULL, 0x5BFD19B3B2D595E1ULL, 0xA9F492DC27460979ULL,
+  0x13C24B1E7D6DA40BULL, 0x62F123AFC763EC13ULL, 0x688C62AEF4E10B5CULL,
+  0x32A8BA71DF6204A8ULL, 0x59B3270F3E46E5BDULL, 0x6CB61C0D30059A5EULL,
+  0x3341047BE137BD2FULL, 0x1CB40BAC574A4A3AULL, 0x99B8CE1354D5C528ULL,
+  0xE24EC11A72651E3FULL, 0xCA6715E332FB0B62ULL, 0xD276B12F1A40D166ULL,
+  0x125A4B8BECFA31D6ULL, 0x55D6350DB3286AF6ULL, 0xA050B0D0D7D37C7BULL,
+  0xC2FF591EFB0D69ECULL, 0x2DC049AAC1867932ULL, 0x2B51724B9533B761ULL,
+  0x94758D7CC99A2811ULL, 0x691DBF36300383C8ULL, 0x77BDE3F8087D0CA4ULL,
+  0x29DD77E5DA2D51DBULL, 0xCAA985087344E4D6ULL, 0x38468B3C946CA21AULL,
+  0x396B8DB9DB5882CCULL, 0x97098053DB069C22ULL, 0xC84AE47F5D1B05BCULL,
+  0xE14B210047A53F0EULL, 0x3200472CB4FFB9E2ULL, 0xD2A197F3F74B3CECULL,
+  0xAAD76A92A3297AF5ULL
+};
+
+unsigned long long llhash_general(void *data, unsigned int length)
+{
+  unsigned long long h;
+  char *k;
+  unsigned int j;
 
   k = (char*)data;
   h=0xBB40E64DA205B064LL;
   j=0;
 
   while (length ? j++ < length : *k) {
-    h = (h * 7664345821815920749LL) ^ hash_tab[(unsigned char)(*k)];
+    h = (h * 7664345821815920749LL) ^ llhash_tab[(unsigned char)(*k)];
     k++;
   }
 
@@ -62,6 +325,9 @@ unsigned long long llhash_general(void *data, unsigned int length)
 
 #ifdef NETHASH
 
+/* The hash is the low half of llhash_general, or all of it if a */
+/* long holds it, and the rehash is the high half                 */
+
 unsigned long hash_sockaddr(struct sockaddr *sa)
 {
   unsigned long long h;
@@ -72,7 +338,7 @@ unsigned long hash_sockaddr(struct sockaddr *sa)
 
   h = llhash_general((void*)sa, SOCKADDR_SIZEOF(sa));
 
-  return *(unsigned long*)&h;
+  return (unsigned long)h;
 }
 
 unsigned long rehash_sockaddr(struct sockaddr *sa)
@@ -85,7 +351,22 @@ unsigned long rehash_sockaddr(struct sockaddr *sa)
 
   h = llhash_general((void*)sa, SOCKADDR_SIZEOF(sa));
 
-  return * ( ((unsigned long*)&h) + 1 );
+  return (unsigned long)(h >> 32);
+}
+
+unsigned long hash_sockaddr_dual(struct sockaddr *sa, unsigned long *rehash)
+{
+  unsigned long long h;
+
+  if(sa == NULL) {
+    *rehash = 0;
+    return 0;
+  }
+
+  h = llhash_general((void*)sa, SOCKADDR_SIZEOF(sa));
+
+  *rehash = (unsigned long)(h >> 32);
+  return (unsigned long)h;
 }
 
 #endif /* NETHASH */
@@ -5,6 +5,8 @@
  * In this file, if we define NETHASH, we get functions to generate a hash from a sockaddr
  * 
  */
+#include <stddef.h>
+
 #ifdef NETHASH
 #include <netinet/in.h>
 #endif
@@ -13,6 +15,30 @@ unsigned long hash_string(const char *string);
 
 unsigned long rehash_string(const char *string);
 
+/* the same hashes over exactly len bytes, which may include '\0's; */
+/* for a string they agree with the functions above given strlen    */
+unsigned long hash_string_n(const char *string, size_t len);
+
+unsigned long rehash_string_n(const char *string, size_t len);
+
+/* wyhash: 64 bit hashes read a word at a time, much faster on long */
+/* keys and much better mixed than the ones above; the rehash is a   */
+/* differently seeded hash                                           */
+unsigned long long hash_string64(const char *string);
+
+unsigned long long rehash_string64(const char *string);
+
+unsigned long long hash_string64_n(const char *string, size_t len);
+
+unsigned long long rehash_string64_n(const char *string, size_t len);
+
+/* hash_string64 and a second hash of the same 128 bit pass, put in  */
+/* *rehash, for a hashtable_new_dual table's hsh2fn                  */
+unsigned long hash_string_dual(const char *string, unsigned long *rehash);
+
+unsigned long hash_string_dual_n(const char *string, size_t len,
+				 unsigned long *rehash);
+
 unsigned long long llhash_general(void *data, unsigned int length);
 
 
@@ -26,6 +52,9 @@ unsigned long hash_sockaddr(struct sockaddr *sa);
 
 unsigned long rehash_sockaddr(struct sockaddr *sa);
 
+/* both of the above from one llhash_general, the rehash put in *rehash */
+unsigned long hash_sockaddr_dual(struct sockaddr *sa, unsigned long *rehash);
+
 #endif
 
 
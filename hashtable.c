@@ -1,3 +1,7 @@
+#include <limits.h>
+#include <string.h>
+#include <pthread.h>
+
 #include "hashtable.h"
 
 /**
@@ -5,11 +9,108 @@
  * 
  */
 static unsigned long ithprime(size_t i);
-static void *inserted(hashtable *master, unsigned long h, void *item, int copying);
-static void *putintbl(hashtable *master, void *item, int copying);
+static unsigned long stepsize(hashtable *master, void *item,
+			      unsigned long rv);
+static unsigned long hashof(hashtable *master, void *item,
+			    unsigned long *rv);
+static unsigned long givenhv(hashtable *master, void *item,
+			     unsigned long hv, unsigned long *rv);
+static hashtable *newmaster(hshfn hash, hshfn rehash, hsh2fn hash2,
+			    hshcmpfn cmp,
+			    hshdupfn dupe, hshfreefn undupe,
+			    unsigned int flags);
+static int newtbl(hashtable *master, unsigned long size);
+static void setslot(hashtable *master, unsigned long h,
+		    void *item, unsigned long hv);
+static void *inserted(hashtable *master, unsigned long h, unsigned long hv,
+		      void *item, int copying);
+static void *putintbl(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv, int copying);
 static int reorganize(hashtable *master);
-static int found(hashtable *master, unsigned long h, void *item);
-static unsigned long huntup(hashtable *master, void *item);
+static unsigned long growsize(hashtable *master, unsigned long size);
+static unsigned long fitsize(hashtable *master, unsigned long n);
+static void shrink(hashtable *master);
+static int rebuild(hashtable *master, unsigned long newsize,
+		   int incremental);
+static int found(hashtable *master, unsigned long h, unsigned long hv,
+		 void *item);
+static unsigned long huntup(hashtable *master, void *item, unsigned long hv,
+			    unsigned long rv);
+static void *rhput(hashtable *master, void *item, unsigned long hv,
+		   int copying);
+static unsigned long rhhunt(hashtable *master, void *item, unsigned long hv);
+static void rhdelete(hashtable *master, unsigned long h);
+static unsigned long locate(hashtable *master, void *item, unsigned long hv,
+			    unsigned long rv);
+static int makeroom(hashtable *master);
+static void *inserthv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv);
+static void *upserthv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv, hshupdfn update);
+static void *updateat(hashtable *master, unsigned long h, void *item,
+		      hshupdfn update);
+static void *findhv(hashtable *master, void *item, unsigned long hv,
+		    unsigned long rv);
+static void *removehv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv);
+static void prefetchhome(hashtable *master, unsigned long hv);
+static void *dupitem(hashtable *master, void *item);
+static int timedreorganize(hashtable *master);
+static int scanslots(hashtable *master, unsigned long *pos,
+		     unsigned long to, hshexecfn exec, void *datum,
+		     int *stop);
+static void *foreachworker(void *job);
+
+/* One worker's share of hashtable_foreach_parallel */
+typedef struct foreachjob_s foreachjob;
+struct foreachjob_s {
+  hashtable *m;
+  hshexecfn exec;
+  void *datum;
+  unsigned long from, to;      /* positions as for scanslots */
+  int *stop;                   /* set once any worker fails */
+  int err;
+};
+static void instrop(hashtable *master, int op, unsigned long probes);
+static void instrsample(hashtable *master);
+static void swaptbl(hashtable *master);
+static void migrate(hashtable *master, unsigned long nslots);
+static void *oldlocate(hashtable *master, void *item, unsigned long hv,
+		       unsigned long rv, int removing);
+
+/* The item pointer held in slot i, whichever layout is in use */
+#define SLOTITEM(m, i) (((m)->flags & HSH_CACHEHASH)	\
+			? (m)->hslots[i].item : (m)->htbl[i])
+
+/* The home slot for a hash value.  Prime sized tables take it  */
+/* modulo size, HSH_POW2 tables mix the bits and then mask.      */
+#define HOMESLOT(m, hv) (((m)->flags & HSH_POW2)			\
+			 ? hshmix(hv) & ((m)->size - 1)		\
+			 : (hv) % (m)->size)
+
+/* The slot h2 further along the probe sequence from h */
+#define NEXTSLOT(m, h, h2) (((m)->flags & HSH_POW2)		\
+			    ? ((h) + (h2)) & ((m)->size - 1)	\
+			    : ((h) + (h2)) % (m)->size)
+
+/* How far the item in slot i of a Robin Hood table sits past */
+/* its home slot                                               */
+#define RHDIST(m, i) (((i) - HOMESLOT(m, (m)->hslots[i].hval))	\
+		      & ((m)->size - 1))
+
+/* Whether an item copied to a new table must be hashed again:  */
+/* its slot did not cache the hash, or the probe step needs the  */
+/* rehash that a hsh2fn only hands out with it                   */
+#define COPYHASHES(m) (!((m)->flags & HSH_CACHEHASH) ||			\
+		       (((m)->hash2 != NULL) &&				\
+			!((m)->flags & HSH_ROBINHOOD)))
+
+/* A hint to start loading the cache line at p */
+#ifdef __GNUC__
+#define PREFETCH(p) __builtin_prefetch(p)
+#else
+#define PREFETCH(p)
+#endif
 
 /* Threshold above which reorganization is desirable */
 #define TTHRESH(sz) (sz - (sz >> 3))
@@ -31,12 +132,46 @@ static int primetbl[] = {45, 45, 41, 45, 45, 45, 45, 49,
 hashtable *hashtable_new(hshfn hash, hshfn rehash,
 			 hshcmpfn cmp,
 			 hshdupfn dupe, hshfreefn undupe)
+{
+  return hashtable_new_flags(hash, rehash, cmp, dupe, undupe, 0);
+}
+
+hashtable *hashtable_new_flags(hshfn hash, hshfn rehash,
+			       hshcmpfn cmp,
+			       hshdupfn dupe, hshfreefn undupe,
+			       unsigned int flags)
+{
+  /* Robin Hood tables never step by a rehash */
+  if((hash == NULL) ||
+     ((rehash == NULL) && !(flags & HSH_ROBINHOOD))) {
+    return NULL;
+  }
+
+  return newmaster(hash, rehash, NULL, cmp, dupe, undupe, flags);
+}
+
+hashtable *hashtable_new_dual(hsh2fn hash2,
+			      hshcmpfn cmp,
+			      hshdupfn dupe, hshfreefn undupe,
+			      unsigned int flags)
+{
+  if(hash2 == NULL) {
+    return NULL;
+  }
+
+  return newmaster(NULL, NULL, hash2, cmp, dupe, undupe, flags);
+}
+
+/* The body of the constructors above.  hash and rehash are */
+/* NULL if hash2 is not.                                    */
+static hashtable *newmaster(hshfn hash, hshfn rehash, hsh2fn hash2,
+			    hshcmpfn cmp,
+			    hshdupfn dupe, hshfreefn undupe,
+			    unsigned int flags)
 {
   hashtable *master;
   
-  if((hash == NULL) ||
-     (rehash == NULL) ||
-     (cmp == NULL)) {
+  if(cmp == NULL) {
     return NULL;
   }
   
@@ -44,16 +179,22 @@ hashtable *hashtable_new(hshfn hash, hshfn rehash,
   if(master == NULL) {
     return NULL;
   }
+
+  if (flags & HSH_ROBINHOOD) {
+    /* distances come from the cached hash and a masked home slot */
+    flags |= HSH_CACHEHASH | HSH_POW2;
+  }
+  master->flags = flags;
   
-  master->htbl = calloc(HASHTABLE_STARTSIZE, sizeof(*(master->htbl)));
-  if(master->htbl == NULL) {
+  if(!newtbl(master, (flags & HSH_POW2) ? HASHTABLE_POW2STARTSIZE
+	                                  : HASHTABLE_STARTSIZE)) {
     free(master);
     return NULL;
   }
 
-  master->size = HASHTABLE_STARTSIZE;
   master->hash = hash;
   master->rehash = rehash;
+  master->hash2 = hash2;
   master->cmp = cmp;
   master->dupe = dupe;
   master->undupe = undupe;
@@ -67,6 +208,53 @@ hashtable *hashtable_new(hshfn hash, hshfn rehash,
   return master;
 }
 
+hashtable *hashtable_new_arena(hshfn hash, hshfn rehash,
+			       hshcmpfn cmp, hshadupfn adupe,
+			       size_t chunksize, unsigned int flags)
+{
+  hashtable *master;
+
+  if (adupe == NULL) {
+    return NULL;
+  }
+
+  master = hashtable_new_flags(hash, rehash, cmp, NULL, NULL, flags);
+  if (master == NULL) {
+    return NULL;
+  }
+
+  master->harena = arena_new(chunksize);
+  if (master->harena == NULL) {
+    hashtable_free(master);
+    return NULL;
+  }
+  master->adupe = adupe;
+
+  return master;
+}
+
+hashtable *hashtable_new_bulk(hshfn hash, hshfn rehash,
+			      hshcmpfn cmp,
+			      hshdupfn dupe, hshfreefn undupe,
+			      unsigned int flags,
+			      void **items, size_t n)
+{
+  hashtable *master;
+
+  master = hashtable_new_flags(hash, rehash, cmp, dupe, undupe, flags);
+  if (master == NULL) {
+    return NULL;
+  }
+
+  if ((hashtable_reserve(master, n) != 0) ||
+      (hashtable_insert_batch(master, items, NULL, n) != n)) {
+    hashtable_free(master);
+    return NULL;
+  }
+
+  return master;
+}
+
 void hashtable_free(hashtable *m)
 {
   unsigned long i;
@@ -75,18 +263,46 @@ void hashtable_free(hashtable *m)
   if(m == NULL) {
     return;
   }
+
+  if (m->harena != NULL) {
+    /* the items all live in the arena, no need to visit them */
+    arena_free(m->harena);
+    free(m->hinstr);
+    free(m->oldhtbl);
+    free(m->oldhslots);
+    free(m->htbl);
+    free(m->hslots);
+    free(m);
+    return;
+  }
+
+  /* unload whatever has not been migrated out of an old table */
+  if (m->oldsize != 0) {
+    swaptbl(m);
+    for (i = m->migrated; i < m->size; i++) {
+      if ((h = SLOTITEM(m, i)) && ((void*)m != h) &&
+	  (m->undupe != NULL)) {
+	m->undupe(h);
+      }
+    }
+    free(m->htbl);
+    free(m->hslots);
+    swaptbl(m);
+  }
   
   /* unload the actual data storage */
   for (i = 0; i < m->size; i++) {
-    if ((h = m->htbl[i]) && ((void*)m != h)) {
+    if ((h = SLOTITEM(m, i)) && ((void*)m != h)) {
       if(m->undupe != NULL) {
-	m->undupe(m->htbl[i]);
+	m->undupe(h);
       }
     }
   }
   
   /* free the table */
   free(m->htbl);
+  free(m->hslots);
+  free(m->hinstr);
   /* free the container structure */
   free(m);
 }
@@ -94,76 +310,358 @@ void hashtable_free(hashtable *m)
 
 void *hashtable_insert(hashtable *m, void *item)
 {
+  unsigned long hv, rv;
+
   if(m == NULL) {
     return NULL;
   }
 
-  if ((TSPACE(m) <= 0) && !reorganize(m)) {
-    m->hstatus.herror |= hshTBLFULL;
+  hv = hashof(m, item, &rv);
+  return inserthv(m, item, hv, rv);
+}
+
+
+void *hashtable_upsert(hashtable *m, void *item, hshupdfn update)
+{
+  unsigned long hv, rv;
+
+  if((m == NULL) ||
+     (update == NULL)) {
     return NULL;
   }
 
-  return putintbl(m, item, 0);
+  hv = hashof(m, item, &rv);
+  return upserthv(m, item, hv, rv, update);
 }
 
 
 void *hashtable_find(hashtable *m, void *item)
 {
-  unsigned long h;
+  unsigned long hv, rv;
 
   if(m == NULL) {
     return NULL;
   }
 
-  h = huntup(m, item);
-  return m->htbl[h];
+  hv = hashof(m, item, &rv);
+  return findhv(m, item, hv, rv);
+}
+
+
+size_t hashtable_find_batch(hashtable *m, void **items, void **results,
+			    size_t n)
+{
+  unsigned long hv[HASHTABLE_BATCH], rv[HASHTABLE_BATCH];
+  size_t i, j, chunk, nfound;
+
+  if((m == NULL) ||
+     (items == NULL) ||
+     (results == NULL)) {
+    return 0;
+  }
+
+  nfound = 0;
+  for (i = 0; i < n; i += chunk) {
+    chunk = (n - i < HASHTABLE_BATCH) ? n - i : HASHTABLE_BATCH;
+
+    /* hash the lot and get their home slots on the way in */
+    for (j = 0; j < chunk; j++) {
+      hv[j] = hashof(m, items[i + j], &rv[j]);
+      prefetchhome(m, hv[j]);
+    }
+
+    for (j = 0; j < chunk; j++) {
+      results[i + j] = findhv(m, items[i + j], hv[j], rv[j]);
+      if (results[i + j] != NULL) {
+	nfound++;
+      }
+    }
+  }
+
+  return nfound;
+}
+
+
+size_t hashtable_insert_batch(hashtable *m, void **items, void **results,
+			      size_t n)
+{
+  unsigned long hv[HASHTABLE_BATCH], rv[HASHTABLE_BATCH];
+  size_t i, j, chunk, nstored;
+  void *stored;
+
+  if((m == NULL) ||
+     (items == NULL)) {
+    return 0;
+  }
+
+  /* grow once up front rather than part way through, so the */
+  /* prefetched slots are still the right ones.  n counts any */
+  /* duplicates too, so it may ask for more than the table    */
+  /* can have; a failure leaves the table as it was, and the  */
+  /* inserts below grow it as far as they need                */
+  if (!(m->flags & HSH_INCREMENTAL)) {
+    (void) hashtable_reserve(m, n);
+  }
+
+  nstored = 0;
+  for (i = 0; i < n; i += chunk) {
+    chunk = (n - i < HASHTABLE_BATCH) ? n - i : HASHTABLE_BATCH;
+
+    for (j = 0; j < chunk; j++) {
+      hv[j] = hashof(m, items[i + j], &rv[j]);
+      prefetchhome(m, hv[j]);
+    }
+
+    for (j = 0; j < chunk; j++) {
+      stored = inserthv(m, items[i + j], hv[j], rv[j]);
+      if (results != NULL) {
+	results[i + j] = stored;
+      }
+      if (stored != NULL) {
+	nstored++;
+      }
+    }
+  }
+
+  return nstored;
 }
 
 
 void *hashtable_remove(hashtable *m, void *item)
 {
-  unsigned long h;
-  void *olditem;
+  unsigned long hv, rv;
 
   if(m == NULL) {
     return NULL;
   }
 
-  h = huntup(m, item);
-  olditem = m->htbl[h];
+  hv = hashof(m, item, &rv);
+  return removehv(m, item, hv, rv);
+}
+
+
+void *hashtable_find_hv(hashtable *m, void *item, unsigned long hv)
+{
+  unsigned long rv;
 
-  if(olditem != NULL) {
-    /* todo: why arent we setting this to NULL? */
-    m->htbl[h] = (void*)m;
-    m->hstatus.hdeleted++;
+  if(m == NULL) {
+    return NULL;
   }
-  
-  return olditem;
+
+  hv = givenhv(m, item, hv, &rv);
+  return findhv(m, item, hv, rv);
+}
+
+
+void *hashtable_insert_hv(hashtable *m, void *item, unsigned long hv)
+{
+  unsigned long rv;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = givenhv(m, item, hv, &rv);
+  return inserthv(m, item, hv, rv);
+}
+
+
+void *hashtable_remove_hv(hashtable *m, void *item, unsigned long hv)
+{
+  unsigned long rv;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = givenhv(m, item, hv, &rv);
+  return removehv(m, item, hv, rv);
 }
 
 
 int hashtable_foreach(hashtable *m, hshexecfn exec, void *datum)
 {
-  int err;
-  unsigned long i;
-  void *hh;
+  unsigned long pos;
 
   if ((m == NULL) ||
       (exec == NULL)) {
     return -1; 
   }
 
-  for (i = 0; i < m->size; i++) {
-    hh = m->htbl[i];
-    if((hh != NULL) &&
-       (hh != (void*)m)) {
-      err = exec(hh, datum);
-      if(err != 0) {
-	return err;
+  pos = 0;
+  return scanslots(m, &pos, m->size + m->oldsize, exec, datum, NULL);
+}
+
+int hashtable_foreach_parallel(hashtable *m, hshexecfn exec,
+			       void **datums, unsigned int nthreads,
+			       hshmergefn merge, void *result)
+{
+  foreachjob *jobs;
+  pthread_t *threads;
+  unsigned long total;
+  unsigned int t, started;
+  int stop, err;
+
+  if ((m == NULL) ||
+      (exec == NULL) ||
+      (datums == NULL) ||
+      (nthreads == 0)) {
+    return -1;
+  }
+
+  jobs = calloc(nthreads, sizeof(*jobs));
+  threads = calloc(nthreads, sizeof(*threads));
+  if ((jobs == NULL) ||
+      (threads == NULL)) {
+    free(jobs);
+    free(threads);
+    return -1;
+  }
+
+  /* each worker gets an equal run of slots, old table included */
+  stop = 0;
+  total = m->size + m->oldsize;
+  for (t = 0; t < nthreads; t++) {
+    jobs[t].m = m;
+    jobs[t].exec = exec;
+    jobs[t].datum = datums[t];
+    jobs[t].from = total / nthreads * t;
+    jobs[t].to = (t == nthreads - 1) ? total : total / nthreads * (t + 1);
+    jobs[t].stop = &stop;
+    jobs[t].err = 0;
+  }
+
+  /* the calling thread takes the first run itself, and any run */
+  /* a thread could not be started for                          */
+  for (started = 1; started < nthreads; started++) {
+    if (pthread_create(&threads[started], NULL, foreachworker,
+		       &jobs[started]) != 0) {
+      break;
+    }
+  }
+  (void) foreachworker(&jobs[0]);
+  for (t = started; t < nthreads; t++) {
+    (void) foreachworker(&jobs[t]);
+  }
+  for (t = 1; t < started; t++) {
+    pthread_join(threads[t], NULL);
+  }
+
+  err = 0;
+  for (t = 0; t < nthreads; t++) {
+    if ((err == 0) &&
+	(jobs[t].err != 0)) {
+      err = jobs[t].err;
+    }
+  }
+
+  if ((err == 0) &&
+      (merge != NULL)) {
+    for (t = 0; t < nthreads; t++) {
+      err = merge(result, datums[t]);
+      if (err != 0) {
+	break;
       }
     }
   }
 
+  free(jobs);
+  free(threads);
+  return err;
+}
+
+void hashtable_cursor_init(hshcursor *c)
+{
+  if (c == NULL) {
+    return;
+  }
+
+  c->pos = 0;
+  c->done = 0;
+}
+
+int hashtable_foreach_chunk(hashtable *m, hshcursor *c,
+			    unsigned long maxslots,
+			    hshexecfn exec, void *datum)
+{
+  unsigned long total, to;
+  int err;
+
+  if ((m == NULL) ||
+      (c == NULL) ||
+      (maxslots == 0) ||
+      (exec == NULL)) {
+    return -1;
+  }
+
+  total = m->size + m->oldsize;
+  to = (maxslots < total - c->pos && c->pos < total)
+    ? c->pos + maxslots : total;
+
+  err = scanslots(m, &c->pos, to, exec, datum, NULL);
+  if (c->pos >= total) {
+    c->done = 1;
+  }
+
+  return err;
+}
+
+int hashtable_reserve(hashtable *m, unsigned long n)
+{
+  unsigned long newsize;
+
+  if(m == NULL) {
+    return -1;
+  }
+
+  if (TSPACE(m) >= (long)n) {
+    return 0;
+  }
+
+  /* the whole of any migration goes into the new table too */
+  migrate(m, m->oldsize);
+
+  newsize = m->size;
+  while (newsize && ((long)TTHRESH(newsize) - (long)m->hstatus.hentries
+		     + (long)m->hstatus.hdeleted < (long)n)) {
+    newsize = growsize(m, newsize);
+  }
+
+  /* the table is left as it was and still usable, so this is */
+  /* not recorded in herror, which would stop inserts probing   */
+  if ((newsize == 0) || !rebuild(m, newsize, 0)) {
+    return -1;
+  }
+
+  return 0;
+}
+
+int hashtable_shrink_policy(hashtable *m, unsigned int lowwater)
+{
+  if((m == NULL) ||
+     (lowwater > HASHTABLE_MAXLOWWATER)) {
+    return -1;
+  }
+
+  m->lowwater = lowwater;
+  return 0;
+}
+
+int hashtable_compact(hashtable *m)
+{
+  unsigned long newsize;
+
+  if(m == NULL) {
+    return -1;
+  }
+
+  migrate(m, m->oldsize);
+
+  newsize = fitsize(m, m->hstatus.hentries - m->hstatus.hdeleted);
+  if ((newsize == 0) || !rebuild(m, newsize, 0)) {
+    return -1;
+  }
+
   return 0;
 }
 
@@ -176,6 +674,44 @@ hshstats *hashtable_stats(hashtable *m)
   return &(m->hstatus);
 }
 
+int hashtable_instrument(hashtable *m, unsigned long sampleevery)
+{
+  if(m == NULL) {
+    return -1;
+  }
+
+  if(sampleevery == 0) {
+    free(m->hinstr);
+    m->hinstr = NULL;
+    return 0;
+  }
+
+  if(m->hinstr == NULL) {
+    m->hinstr = malloc(sizeof(*(m->hinstr)));
+    if(m->hinstr == NULL) {
+      return -1;
+    }
+  }
+
+  memset(m->hinstr, 0, sizeof(*(m->hinstr)));
+  m->hinstr->sampleevery = sampleevery;
+  instrsample(m);
+
+  return 0;
+}
+
+int hashtable_instr_snapshot(hashtable *m, hshinstr *snap)
+{
+  if((m == NULL) ||
+     (m->hinstr == NULL) ||
+     (snap == NULL)) {
+    return -1;
+  }
+
+  *snap = *(m->hinstr);
+  return 0;
+}
+
 
 /* ============= Useful generic functions ============= */
 
@@ -209,6 +745,25 @@ unsigned long hshstrehash(const char * string)
   return hash;
 }
 
+/* The finalizer is murmur3 fmix64, or fmix32 for a 32 bit long */
+unsigned long hshmix(unsigned long hv)
+{
+#if ULONG_MAX > 0xffffffffUL
+  hv ^= hv >> 33;
+  hv *= 0xff51afd7ed558ccdUL;
+  hv ^= hv >> 33;
+  hv *= 0xc4ceb9fe1a85ec53UL;
+  hv ^= hv >> 33;
+#else
+  hv ^= hv >> 16;
+  hv *= 0x85ebca6bUL;
+  hv ^= hv >> 13;
+  hv *= 0xc2b2ae35UL;
+  hv ^= hv >> 16;
+#endif
+  return hv;
+}
+
 /* So the prime of interest, vs index i into above table,   */
 /* is    ( 2**(FIRSTN + i) ) - primetbl[i]                  */
 /* The above table suffices for about 48,000,000 entries.   */
@@ -224,12 +779,89 @@ static unsigned long ithprime(size_t i)
   }
 }
 
+/* The double hashing step for item, always 1 <= step < size/8. */
+/* An HSH_POW2 step is made odd, so it is coprime with the size */
+/* and the probe sequence still visits every slot.              */
+/* rv is the rehash from hashof, used if the table has a hsh2fn. */
+static unsigned long stepsize(hashtable *master, void *item,
+			      unsigned long rv)
+{
+  if (master->hash2 == NULL) {
+    rv = master->rehash(item);
+  }
+  if (master->flags & HSH_POW2) {
+    return (rv & ((master->size >> 3) - 1)) | 1;
+  }
+  return rv % (master->size >> 3) + 1;
+}
+
+/* The hash of item.  A table with a hsh2fn gets the rehash in */
+/* the same call and puts it in *rv, otherwise *rv is 0 and    */
+/* stepsize calls rehash itself if a probe misses.             */
+static unsigned long hashof(hashtable *master, void *item,
+			    unsigned long *rv)
+{
+  if (master->hash2 != NULL) {
+    return master->hash2(item, rv);
+  }
+  *rv = 0;
+  return master->hash(item);
+}
+
+/* The hash of item for the _hv functions, which were handed */
+/* hv.  As hashof, but a table without a hsh2fn keeps hv.    */
+static unsigned long givenhv(hashtable *master, void *item,
+			     unsigned long hv, unsigned long *rv)
+{
+  if (master->hash2 != NULL) {
+    return master->hash2(item, rv);
+  }
+  *rv = 0;
+  return hv;
+}
+
+/* Allocate an empty table of size slots in whichever layout */
+/* master uses, and make it current.  The previous table is  */
+/* not freed, the caller must have kept hold of it.          */
+/* Returns 0 if the allocation failed, master is unchanged.  */
+static int newtbl(hashtable *master, unsigned long size)
+{
+  if (master->flags & HSH_CACHEHASH) {
+    hshslot *slots = calloc(size, sizeof(*slots));
+    if (slots == NULL) {
+      return 0;
+    }
+    master->hslots = slots;
+  } else {
+    void **tbl = calloc(size, sizeof(*tbl));
+    if (tbl == NULL) {
+      return 0;
+    }
+    master->htbl = tbl;
+  }
+
+  master->size = size;
+  return 1;
+}
+
+/* Store item, whose hash() value is hv, in the hth slot */
+static void setslot(hashtable *master, unsigned long h,
+		    void *item, unsigned long hv)
+{
+  if (master->flags & HSH_CACHEHASH) {
+    master->hslots[h].item = item;
+    master->hslots[h].hval = hv;
+  } else {
+    master->htbl[h] = item;
+  }
+}
 
 /* Attempt to insert item at the hth position in the table */
 /* Returns NULL if position already taken or if dupe fails */
 /* (when master->herror is set to hshNOMEM)                */
 static void *inserted(hashtable *master, 
 		      unsigned long h,
+		      unsigned long hv,
 		      void *item,
 		      int copying)  /* during reorganization */
 {
@@ -238,7 +870,7 @@ static void *inserted(hashtable *master,
   /* increment probe counter */
   master->hstatus.probes++;
 
-  hh = master->htbl[h];
+  hh = SLOTITEM(master, h);
 
   if (hh == NULL) {
     /* slot is empty */
@@ -247,45 +879,55 @@ static void *inserted(hashtable *master,
        its already been dup'd once, or, am I not making a copy-table,
        and should attempty to make a dup of the item */
     if(copying) {  
-      master->htbl[h] = item;
-    } else if ((master->htbl[h] = (master->dupe == NULL) ? item : master->dupe(item))) {
+      hh = item;
+    } else if ((hh = dupitem(master, item))) {
       /* new entry, so dupe and insert */
       master->hstatus.hentries++;          /* count 'em */
     } else {
       master->hstatus.herror |= hshNOMEM;
+      return NULL;
     }
+    setslot(master, h, hh, hv);
   } else if (copying) {
     return NULL; /* no compare if copying */
   } else if (hh == (void*)master) {
     return NULL;  /* nor if DELETED */
-  } else if (0 != master->cmp(master->htbl[h], item)) {
+  } else if ((master->flags & HSH_CACHEHASH) &&
+	     (master->hslots[h].hval != hv)) {
+    return NULL;  /* nor if the cached hash differs */
+  } else if (0 != master->cmp(hh, item)) {
     /* not found here */
     return NULL;
   }
 
   /* else found already inserted here */
-  return master->htbl[h];
+  return hh;
 } /* inserted */
 
-static void *putintbl(hashtable *master, void *item, int copying)
+static void *putintbl(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv, int copying)
 {
   unsigned long h;
   unsigned long h2;
   void *stored;
 
-  h = master->hash(item) % master->size;
-  stored = inserted(master, h, item, copying);
+  if (master->flags & HSH_ROBINHOOD) {
+    return rhput(master, item, hv, copying);
+  }
+
+  h = HOMESLOT(master, hv);
+  stored = inserted(master, h, hv, item, copying);
 
   if ((stored == NULL) && 
       (master->hstatus.herror == hshOK)) {
     /* if the item was not already in the table, and we do not have
        any errors */
-    h2 = master->rehash(item) % (master->size >> 3) + 1;
+    h2 = stepsize(master, item, rv);
     do {       /* we had to go past 1 per item */
       master->hstatus.misses++;
-      h = (h + h2) % master->size;
+      h = NEXTSLOT(master, h, h2);
 
-      stored = inserted(master, h, item, copying);
+      stored = inserted(master, h, hv, item, copying);
     } while ((stored == NULL) &&
 	     (master->hstatus.herror == hshOK));
   }
@@ -293,51 +935,151 @@ static void *putintbl(hashtable *master, void *item, int copying)
 }
 
 /* Increase the table size by roughly a factor of 2    */
-/* reinsert all entries from the old table in the new. */
-/* revise the size value to match                 */
-/* free the storage for the old table.                 */
+/* (exactly 2 for HSH_POW2), unless clearing out the   */
+/* DELETED entries will make enough room, and rebuild. */
 static int reorganize(hashtable *master)
 {
-  void **newtbl;
-  void **oldtbl;
-  unsigned long newsize, oldsize;
-  unsigned long oldentries, j;
-  unsigned int i;
-
-  oldsize = master->size;
-  oldtbl =  master->htbl;
-  oldentries = 0;
+  unsigned long newsize;
 
   if (master->hstatus.hdeleted > (master->hstatus.hentries / 4))
     /* don't expand table if we can get reasonable space by simply
        removing the accumulated DELETED entries - reasonable space
        being that more than 1/4 of the total entries have been
        deleted */
-    newsize = oldsize;
+    newsize = master->size;
   else {
+    newsize = growsize(master, master->size);
+  }
+
+  return rebuild(master, newsize, master->flags & HSH_INCREMENTAL);
+}
+
+/* The next table size up from size, or 0 if there is none */
+static unsigned long growsize(hashtable *master, unsigned long size)
+{
+  unsigned long newsize;
+  unsigned int i;
+
+  if (master->flags & HSH_POW2) {
+    /* doubling is only bounded by what we can address */
+    newsize = size << 1;
+    if ((newsize < size) ||
+	(newsize > ((unsigned long)-1) / sizeof(hshslot))) {
+      newsize = 0;
+    }
+  } else {
     /* all ithprime usage is here */
     newsize = ithprime(0);
-    for (i = 1; newsize && (newsize <= oldsize); i++) {
+    for (i = 1; newsize && (newsize <= size); i++) {
       newsize = ithprime(i);
     }
   }
 
-  if (newsize != 0) {
-    newtbl = calloc(newsize, sizeof(*newtbl));
-  } else {
+  return newsize;
+}
+
+/* The smallest table size, no smaller than a new table, */
+/* whose threshold is above n, or 0 if there is none      */
+static unsigned long fitsize(hashtable *master, unsigned long n)
+{
+  unsigned long size;
+
+  size = (master->flags & HSH_POW2) ? HASHTABLE_POW2STARTSIZE
+                                    : HASHTABLE_STARTSIZE;
+  while (size && (TTHRESH(size) <= n)) {
+    size = growsize(master, size);
+  }
+
+  return size;
+}
+
+/* Rebuild smaller if the table has fallen below its low-water */
+/* mark.  It is sized for twice what it holds, so that it is   */
+/* not grown again by the next few inserts.  Nothing is done   */
+/* while a migration is under way.                             */
+static void shrink(hashtable *master)
+{
+  unsigned long live, mark, newsize;
+
+  /* lowwater percent of size, rounded down without overflowing */
+  live = master->hstatus.hentries - master->hstatus.hdeleted;
+  mark = master->size / 100 * master->lowwater +
+    master->size % 100 * master->lowwater / 100;
+  if ((master->oldsize != 0) ||
+      (live >= mark)) {
+    return;
+  }
+
+  newsize = fitsize(master, 2 * live);
+  if ((newsize != 0) &&
+      (newsize < master->size)) {
+    /* on failure the table just stays the size it is */
+    (void) rebuild(master, newsize, master->flags & HSH_INCREMENTAL);
+  }
+}
+
+/* Move everything into a new table of newsize slots:  */
+/* reinsert all entries from the old table in the new, */
+/* revise the size value to match, and                 */
+/* free the storage for the old table.                 */
+/* If incremental, just set the old table aside.       */
+static int rebuild(hashtable *master, unsigned long newsize,
+		   int incremental)
+{
+  void **oldtbl;
+  hshslot *oldslots;
+  void *item;
+  unsigned long hv, rv;
+  unsigned long oldsize;
+  unsigned long oldentries, j;
+
+  oldsize = master->size;
+  oldtbl =  master->htbl;
+  oldslots = master->hslots;
+  oldentries = 0;
+
+  if ((newsize == 0) || !newtbl(master, newsize)) {
     /* this is an error being returned - even though its not -really-
        a bad thing */
     return 0;
   }
 
-  master->size = newsize;
-  master->htbl = newtbl;
+  if (incremental) {
+    /* keep the old table, operations from now on move it across */
+    master->oldhtbl = oldtbl;
+    master->oldhslots = oldslots;
+    master->oldsize = oldsize;
+    master->migrated = 0;
+    if (master->flags & HSH_CACHEHASH) {
+      master->htbl = NULL;
+    } else {
+      master->hslots = NULL;
+    }
+
+    /* DELETED entries are simply left behind */
+    master->hstatus.hentries -= master->hstatus.hdeleted;
+    master->hstatus.hdeleted = 0;
+    return 1;
+  }
   
   /* Now reinsert all old entries in new table */
   for (j = 0; j < oldsize; j++) {
-    if ((oldtbl[j] != NULL) &&
-	(oldtbl[j] != (void*)master)) {
-      (void) putintbl(master, oldtbl[j], 1);
+    if (master->flags & HSH_CACHEHASH) {
+      /* the cached hash saves calling hash() on every item again */
+      item = oldslots[j].item;
+      hv = oldslots[j].hval;
+    } else {
+      item = oldtbl[j];
+      hv = 0;
+    }
+
+    if ((item != NULL) &&
+	(item != (void*)master)) {
+      rv = 0;
+      if (COPYHASHES(master)) {
+	hv = hashof(master, item, &rv);
+      }
+      (void) putintbl(master, item, hv, rv, 1);
       oldentries++;
     }
   }
@@ -349,10 +1091,12 @@ static int reorganize(hashtable *master)
     master->hstatus.herror |= hshINTERR;
 
     /* free the new table */
-    free(master->htbl);
+    free((master->flags & HSH_CACHEHASH)
+	 ? (void*)master->hslots : (void*)master->htbl);
 
     /* restore the old table */
     master->htbl = oldtbl;
+    master->hslots = oldslots;
     master->size = oldsize;
     return 0;
   } else {
@@ -363,6 +1107,7 @@ static int reorganize(hashtable *master)
 
     /* free the old table */
     free(oldtbl);
+    free(oldslots);
   }
 
   return 1;
@@ -370,43 +1115,602 @@ static int reorganize(hashtable *master)
 
 /* Attempt to find item at the hth position in the table */
 /* counting attempts.  Returns 1 if found, else 0        */
-static int found(hashtable *master, unsigned long h, void *item)
+static int found(hashtable *master, unsigned long h, unsigned long hv,
+		 void *item)
 {
   void *hh;
 
   /* increment total probecounter */
   master->hstatus.probes++;
   
-  hh = master->htbl[h];
+  hh = SLOTITEM(master, h);
   
   if((hh == NULL) ||
      (hh == (void*)master)) {
     return 0;
   }
+
+  if((master->flags & HSH_CACHEHASH) &&
+     (master->hslots[h].hval != hv)) {
+    /* cached hash differs, no need to look at the item */
+    return 0;
+  }
   
   return !(master->cmp(hh, item));
 }
 
 /* Find the current hashtbl index for item, or an empty slot */
-static unsigned long huntup(hashtable *master, void *item)
+static unsigned long huntup(hashtable *master, void *item, unsigned long hv,
+			    unsigned long rv)
 {
   unsigned long h;
   unsigned long h2;
 
   /* limit h to the size of the table */
-  h = master->hash(item) % master->size;
+  h = HOMESLOT(master, hv);
 
   /* Within this a DELETED item simply causes a rehash */
   /* i.e. treat it like a non-equal item               */
 
-  if (!(found(master, h, item)) && master->htbl[h]) {
-    h2 = master->rehash(item) % (master->size >> 3) + 1;
+  if (!(found(master, h, hv, item)) && SLOTITEM(master, h)) {
+    h2 = stepsize(master, item, rv);
     do {       /* we had to go past 1 per item */
       master->hstatus.misses++;
-      h = (h + h2) % master->size;
-    } while (!(found(master, h, item)) && (master->htbl[h]));
+      h = NEXTSLOT(master, h, h2);
+    } while (!(found(master, h, hv, item)) && SLOTITEM(master, h));
   }
 
   return h;
 }
 
+/* Robin Hood insert.  Walk forward from the home slot until we  */
+/* find item, an empty slot, or an item nearer its own home than */
+/* we are to ours - item can not be any further on.  The new     */
+/* item goes there, and whatever it displaced is carried forward */
+/* the same way until something lands in an empty slot.          */
+static void *rhput(hashtable *master, void *item, unsigned long hv,
+		   int copying)  /* during reorganization */
+{
+  unsigned long h, mask, dist, sdist;
+  hshslot carry, tmp;
+  void *hh;
+
+  mask = master->size - 1;
+  h = HOMESLOT(master, hv);
+  dist = 0;
+
+  for (;;) {
+    master->hstatus.probes++;
+    hh = master->hslots[h].item;
+    if (hh == NULL) {
+      break;
+    }
+    sdist = RHDIST(master, h);
+    if (sdist < dist) {
+      break;
+    }
+    if (!copying &&
+	(master->hslots[h].hval == hv) &&
+	(0 == master->cmp(hh, item))) {
+      /* found already inserted here */
+      return hh;
+    }
+    master->hstatus.misses++;
+    h = (h + 1) & mask;
+    dist++;
+  }
+
+  if (!copying) {
+    item = dupitem(master, item);
+    if (item == NULL) {
+      master->hstatus.herror |= hshNOMEM;
+      return NULL;
+    }
+    master->hstatus.hentries++;
+  }
+
+  carry.item = item;
+  carry.hval = hv;
+  while (master->hslots[h].item != NULL) {
+    sdist = RHDIST(master, h);
+    if (sdist < dist) {
+      tmp = master->hslots[h];
+      master->hslots[h] = carry;
+      carry = tmp;
+      dist = sdist;
+    }
+    h = (h + 1) & mask;
+    dist++;
+  }
+  master->hslots[h] = carry;
+
+  return item;
+}
+
+/* Robin Hood lookup.  Returns the slot holding item, or size if */
+/* it is not in the table.  The search stops early at the first  */
+/* item nearer its home than item would be to its own.           */
+static unsigned long rhhunt(hashtable *master, void *item, unsigned long hv)
+{
+  unsigned long h, mask, dist;
+  void *hh;
+
+  mask = master->size - 1;
+  h = HOMESLOT(master, hv);
+
+  for (dist = 0; ; dist++) {
+    master->hstatus.probes++;
+    hh = master->hslots[h].item;
+    if ((hh == NULL) ||
+	(RHDIST(master, h) < dist)) {
+      return master->size;
+    }
+    if ((hh != (void*)master) &&  /* migrated out, HSH_INCREMENTAL */
+	(master->hslots[h].hval == hv) &&
+	(0 == master->cmp(hh, item))) {
+      return h;
+    }
+    master->hstatus.misses++;
+    h = (h + 1) & mask;
+  }
+}
+
+/* Robin Hood delete by backward shift: every following item that */
+/* is not in its home slot moves back one, so no DELETED marker   */
+/* is needed and the table looks as if item was never inserted    */
+static void rhdelete(hashtable *master, unsigned long h)
+{
+  unsigned long next, mask;
+
+  mask = master->size - 1;
+  next = (h + 1) & mask;
+  while ((master->hslots[next].item != NULL) &&
+	 (RHDIST(master, next) != 0)) {
+    master->hslots[h] = master->hslots[next];
+    h = next;
+    next = (next + 1) & mask;
+  }
+
+  master->hslots[h].item = NULL;
+  master->hslots[h].hval = 0;
+  master->hstatus.hentries--;
+}
+
+/* Find item in the current table, returns its slot or size */
+static unsigned long locate(hashtable *master, void *item, unsigned long hv,
+			    unsigned long rv)
+{
+  unsigned long h;
+
+  if (master->flags & HSH_ROBINHOOD) {
+    return rhhunt(master, item, hv);
+  }
+
+  h = huntup(master, item, hv, rv);
+  return (SLOTITEM(master, h) != NULL) ? h : master->size;
+}
+
+/* Exchange the current table with the one being migrated  */
+/* from, so the probing routines can be pointed at the old */
+/* one.  The migrated count is left alone.                 */
+static void swaptbl(hashtable *master)
+{
+  void **tbl;
+  hshslot *slots;
+  unsigned long size;
+
+  tbl = master->htbl;
+  master->htbl = master->oldhtbl;
+  master->oldhtbl = tbl;
+
+  slots = master->hslots;
+  master->hslots = master->oldhslots;
+  master->oldhslots = slots;
+
+  size = master->size;
+  master->size = master->oldsize;
+  master->oldsize = size;
+}
+
+/* Move up to nslots more slots of the old table into the   */
+/* current one.  Each moved item is left DELETED, which     */
+/* keeps the probe chains of the old table intact for the   */
+/* items still in it.  The old table goes when it is empty. */
+static void migrate(hashtable *master, unsigned long nslots)
+{
+  void *item;
+  unsigned long hv, rv;
+
+  while ((nslots-- > 0) && (master->migrated < master->oldsize)) {
+    if (master->flags & HSH_CACHEHASH) {
+      item = master->oldhslots[master->migrated].item;
+      hv = master->oldhslots[master->migrated].hval;
+    } else {
+      item = master->oldhtbl[master->migrated];
+      hv = 0;
+    }
+
+    /* empty slots must stay empty, they end the old probe chains */
+    if ((item != NULL) &&
+	(item != (void*)master)) {
+      if (master->flags & HSH_CACHEHASH) {
+	master->oldhslots[master->migrated].item = (void*)master;
+      } else {
+	master->oldhtbl[master->migrated] = (void*)master;
+      }
+      rv = 0;
+      if (COPYHASHES(master)) {
+	hv = hashof(master, item, &rv);
+      }
+      (void) putintbl(master, item, hv, rv, 1);
+    }
+    master->migrated++;
+  }
+
+  if ((master->oldsize != 0) &&
+      (master->migrated == master->oldsize)) {
+    free(master->oldhtbl);
+    free(master->oldhslots);
+    master->oldhtbl = NULL;
+    master->oldhslots = NULL;
+    master->oldsize = 0;
+    master->migrated = 0;
+  }
+}
+
+/* Look for item in the old table of a migration, if one is */
+/* still under way.  If it is there and removing, mark its  */
+/* slot DELETED and take it off the entry count.  Returns   */
+/* the item, or NULL.                                       */
+static void *oldlocate(hashtable *master, void *item, unsigned long hv,
+		       unsigned long rv, int removing)
+{
+  unsigned long h;
+  void *olditem;
+
+  if (master->oldsize == 0) {
+    /* the migration may have just finished */
+    return NULL;
+  }
+
+  olditem = NULL;
+  swaptbl(master);
+
+  h = locate(master, item, hv, rv);
+  if (h < master->size) {
+    olditem = SLOTITEM(master, h);
+    if (removing) {
+      /* keep the cached hash, Robin Hood distances need it */
+      if (master->flags & HSH_CACHEHASH) {
+	master->hslots[h].item = (void*)master;
+      } else {
+	master->htbl[h] = (void*)master;
+      }
+      master->hstatus.hentries--;
+    }
+  }
+
+  swaptbl(master);
+  return olditem;
+}
+
+/* Get the table ready for an insert: grow it if it is at */
+/* its threshold, and carry on any migration.  Returns 0   */
+/* if it could not be grown.                               */
+static int makeroom(hashtable *master)
+{
+  if (TSPACE(master) <= 0) {
+    /* a migration must be finished before the next can start */
+    migrate(master, master->oldsize);
+    if (!timedreorganize(master)) {
+      master->hstatus.herror |= hshTBLFULL;
+      return 0;
+    }
+  }
+
+  if (master->oldsize != 0) {
+    migrate(master, HASHTABLE_MIGRATESLOTS);
+  }
+
+  return 1;
+}
+
+/* hashtable_insert, for an item whose hash is already known */
+static void *inserthv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv)
+{
+  unsigned long probes;
+  void *stored;
+
+  if (!makeroom(master)) {
+    return NULL;
+  }
+
+  /* migration is not counted against the insert */
+  probes = master->hstatus.probes;
+  stored = oldlocate(master, item, hv, rv, 0);
+  if (stored == NULL) {
+    stored = putintbl(master, item, hv, rv, 0);
+  }
+
+  if (master->hinstr != NULL) {
+    instrop(master, HSH_OPINSERT, master->hstatus.probes - probes);
+  }
+  return stored;
+}
+
+/* hashtable_upsert, for an item whose hash is already known */
+static void *upserthv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv, hshupdfn update)
+{
+  unsigned long h;
+  unsigned long probes;
+  void *stored;
+  int done;
+
+  if (!makeroom(master)) {
+    return NULL;
+  }
+
+  probes = master->hstatus.probes;
+  stored = NULL;
+  done = 0;
+
+  /* an item not yet migrated is updated where it is */
+  if (master->oldsize != 0) {
+    swaptbl(master);
+    h = locate(master, item, hv, rv);
+    if (h < master->size) {
+      stored = updateat(master, h, item, update);
+      done = 1;
+    }
+    swaptbl(master);
+  }
+
+  if (done) {
+    /* it was in the old table */
+  } else if (master->flags & HSH_ROBINHOOD) {
+    h = rhhunt(master, item, hv);
+    stored = (h < master->size) ? updateat(master, h, item, update)
+                                : rhput(master, item, hv, 0);
+  } else {
+    /* huntup stops at item or at the empty slot it would go in */
+    h = huntup(master, item, hv, rv);
+    if (SLOTITEM(master, h) != NULL) {
+      stored = updateat(master, h, item, update);
+    } else if ((stored = dupitem(master, item)) != NULL) {
+      setslot(master, h, stored, hv);
+      master->hstatus.hentries++;
+    } else {
+      master->hstatus.herror |= hshNOMEM;
+    }
+  }
+
+  if (master->hinstr != NULL) {
+    instrop(master, HSH_OPINSERT, master->hstatus.probes - probes);
+  }
+  return stored;
+}
+
+/* Let update decide what slot h, which holds an item equal */
+/* to item, is to hold.  The cached hash stays as it is.    */
+static void *updateat(hashtable *master, unsigned long h, void *item,
+		      hshupdfn update)
+{
+  void *stored, *updated;
+
+  stored = SLOTITEM(master, h);
+  updated = update(stored, item);
+  if ((updated != NULL) &&
+      (updated != stored)) {
+    if (master->flags & HSH_CACHEHASH) {
+      master->hslots[h].item = updated;
+    } else {
+      master->htbl[h] = updated;
+    }
+  }
+
+  return updated;
+}
+
+/* hashtable_find, for an item whose hash is already known */
+static void *findhv(hashtable *master, void *item, unsigned long hv,
+		    unsigned long rv)
+{
+  unsigned long h;
+  unsigned long probes;
+  void *found;
+
+  if (master->oldsize != 0) {
+    migrate(master, HASHTABLE_MIGRATESLOTS);
+  }
+
+  probes = master->hstatus.probes;
+  h = locate(master, item, hv, rv);
+  if (h < master->size) {
+    found = SLOTITEM(master, h);
+  } else {
+    found = oldlocate(master, item, hv, rv, 0);
+  }
+
+  if (master->hinstr != NULL) {
+    instrop(master, HSH_OPFIND, master->hstatus.probes - probes);
+  }
+  return found;
+}
+
+/* hashtable_remove, for an item whose hash is already known */
+static void *removehv(hashtable *master, void *item, unsigned long hv,
+		      unsigned long rv)
+{
+  unsigned long h;
+  unsigned long probes;
+  void *olditem;
+
+  if (master->oldsize != 0) {
+    migrate(master, HASHTABLE_MIGRATESLOTS);
+  }
+
+  probes = master->hstatus.probes;
+  h = locate(master, item, hv, rv);
+  if (h >= master->size) {
+    olditem = oldlocate(master, item, hv, rv, 1);
+  } else {
+    olditem = SLOTITEM(master, h);
+    if (master->flags & HSH_ROBINHOOD) {
+      rhdelete(master, h);
+    } else {
+      /* todo: why arent we setting this to NULL? */
+      setslot(master, h, (void*)master, 0);
+      master->hstatus.hdeleted++;
+    }
+  }
+
+  if (master->hinstr != NULL) {
+    instrop(master, HSH_OPREMOVE, master->hstatus.probes - probes);
+  }
+
+  if ((olditem != NULL) &&
+      (master->lowwater != 0)) {
+    shrink(master);
+  }
+  
+  return olditem;
+}
+
+/* Start the home slot for hv on its way into the cache */
+static void prefetchhome(hashtable *master, unsigned long hv)
+{
+  unsigned long h;
+
+  h = HOMESLOT(master, hv);
+  if (master->flags & HSH_CACHEHASH) {
+    PREFETCH(&master->hslots[h]);
+  } else {
+    PREFETCH(&master->htbl[h]);
+  }
+}
+
+/* The copy of item that the table will keep */
+static void *dupitem(hashtable *master, void *item)
+{
+  if (master->harena != NULL) {
+    return master->adupe(item, master->harena);
+  }
+
+  return (master->dupe == NULL) ? item : master->dupe(item);
+}
+
+/* reorganize(), timed and sampled if instrumented */
+static int timedreorganize(hashtable *master)
+{
+  clock_t start;
+  double secs;
+  int ok;
+
+  if (master->hinstr == NULL) {
+    return reorganize(master);
+  }
+
+  start = clock();
+  ok = reorganize(master);
+  secs = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+  master->hinstr->reorgs++;
+  master->hinstr->reorgsecs += secs;
+  master->hinstr->reorglast = secs;
+  if (secs > master->hinstr->reorgmax) {
+    master->hinstr->reorgmax = secs;
+  }
+  instrsample(master);
+
+  return ok;
+}
+
+/* Record an operation that looked at probes slots */
+static void instrop(hashtable *master, int op, unsigned long probes)
+{
+  hshinstr *in;
+
+  in = master->hinstr;
+  if (probes >= HSH_HISTBUCKETS) {
+    probes = HSH_HISTBUCKETS - 1;
+  }
+  in->hist[op][probes]++;
+
+  in->ops++;
+  if ((in->ops % in->sampleevery) == 0) {
+    instrsample(master);
+  }
+}
+
+/* Add a sample of how full the table is to the ring */
+static void instrsample(hashtable *master)
+{
+  hshsample *sample;
+
+  sample = &master->hinstr->samples[master->hinstr->nsamples % HSH_SAMPLES];
+  sample->ops = master->hinstr->ops;
+  sample->size = master->size;
+  sample->hentries = master->hstatus.hentries;
+  sample->hdeleted = master->hstatus.hdeleted;
+  master->hinstr->nsamples++;
+}
+
+/* Call exec on the items from *pos up to to, and leave *pos    */
+/* after the last slot looked at.  Positions count through the  */
+/* current table and then on into the old one of a migration.   */
+/* Stops at the first error from exec, or when *stop is set.    */
+static int scanslots(hashtable *master, unsigned long *pos,
+		     unsigned long to, hshexecfn exec, void *datum,
+		     int *stop)
+{
+  unsigned long i;
+  void *hh;
+  int err;
+
+  for (; *pos < to; (*pos)++) {
+    i = *pos;
+    if (i < master->size) {
+      hh = SLOTITEM(master, i);
+    } else {
+      i -= master->size;
+      if (i < master->migrated) {
+	/* already moved across */
+	continue;
+      }
+      hh = (master->flags & HSH_CACHEHASH)
+	? master->oldhslots[i].item : master->oldhtbl[i];
+    }
+
+    if ((hh != NULL) &&
+	(hh != (void*)master)) {
+      err = exec(hh, datum);
+      if (err != 0) {
+	(*pos)++;
+	if (stop != NULL) {
+	  __atomic_store_n(stop, 1, __ATOMIC_RELAXED);
+	}
+	return err;
+      }
+    }
+
+    if ((stop != NULL) &&
+	!(i & 0x3ff) &&
+	__atomic_load_n(stop, __ATOMIC_RELAXED)) {
+      break;
+    }
+  }
+
+  return 0;
+}
+
+/* pthread body for hashtable_foreach_parallel */
+static void *foreachworker(void *job)
+{
+  foreachjob *j;
+
+  j = (foreachjob*)job;
+  j->err = scanslots(j->m, &j->from, j->to, j->exec, j->datum, j->stop);
+  return NULL;
+}
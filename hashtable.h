@@ -15,10 +15,57 @@
 #define _HASHTABLE_H_
 
 #include <stdlib.h>
+#include <time.h>
+
+#include "arena.h"
 
 /* this was "a prime, for easy testing" */
 #define HASHTABLE_STARTSIZE 17
 
+/* Table layout flags, or'ed together and given to               */
+/* hashtable_new_flags().  hashtable_new() uses none of them.    */
+
+/* HSH_CACHEHASH keeps the full hash() value next to each slot   */
+/* pointer, so a probe can reject a mismatch without touching    */
+/* the stored item or calling cmp.  Costs one word per slot.     */
+#define HSH_CACHEHASH 0x01
+
+/* HSH_POW2 sizes the table in powers of two.  hash() output is  */
+/* put through a mixing finalizer and masked instead of being    */
+/* taken modulo a prime, which takes the division out of every   */
+/* probe and lets the table grow past the end of the prime list. */
+#define HSH_POW2 0x02
+
+/* HSH_ROBINHOOD uses linear Robin Hood probing: an insert takes */
+/* the slot of any item that sits closer to its home slot, which */
+/* keeps probe lengths short and even.  hashtable_remove() then  */
+/* shifts the following items back instead of leaving a DELETED  */
+/* marker, so hdeleted stays 0 and chains never silt up.  It     */
+/* implies HSH_CACHEHASH and HSH_POW2, and rehash is not called, */
+/* so it may be NULL.                                            */
+#define HSH_ROBINHOOD 0x04
+
+/* HSH_INCREMENTAL spreads the cost of growing over the        */
+/* operations that follow.  The old table is kept alongside the */
+/* new one, and every insert, find and remove moves the next    */
+/* HASHTABLE_MIGRATESLOTS slots of it across, so no single      */
+/* insert pays for rehashing the whole table.                   */
+#define HSH_INCREMENTAL 0x08
+
+/* slots of the old table migrated per operation, HSH_INCREMENTAL */
+#define HASHTABLE_MIGRATESLOTS 16
+
+/* keys hashed and prefetched ahead by the _batch functions */
+#define HASHTABLE_BATCH 16
+
+/* starting size of an HSH_POW2 table */
+#define HASHTABLE_POW2STARTSIZE 16
+
+/* highest low-water mark hashtable_shrink_policy accepts, in      */
+/* percent.  A table that has just grown is a little under half    */
+/* full, and a higher mark would shrink it straight back.          */
+#define HASHTABLE_MAXLOWWATER 40
+
 /* This is an example of object oriented programming in C, in   */
 /* that it isolates the hashtable functioning from the objects  */
 /* it stores and retrieves.  It is expected to be useful in     */
@@ -26,11 +73,16 @@
 
 /* Note that the user need not be concerned with the table size */
 
-/* This library is intended to be totally re-entrant and thread */
-/* safe.  It can provide storage and lookup for arbitrary data  */
-/* items of arbitrary types.  The hshkill() function will       */
-/* release all associated storage, after which hshinit() is     */
-/* needed before using the database again.                      */
+/* This library is re-entrant: all state is in the hashtable,   */
+/* so separate tables may be used from separate threads.  It is */
+/* NOT thread safe: even hashtable_find() updates the probes    */
+/* and misses statistics, so a hashtable shared between threads */
+/* needs external locking on every call.  chashtable and        */
+/* shardtable are made for sharing.  It can provide storage and */
+/* lookup for arbitrary data items of arbitrary types.  The     */
+/* hshkill() function will release all associated storage,      */
+/* after which hshinit() is needed before using the database    */
+/* again.                                                       */
 
 /* The pointers returned by hshinsert() and hshfind() may be    */
 /* used to modify the data items, PROVIDED THAT such does NOT   */
@@ -55,6 +107,11 @@
 /* The quality of these functions strongly affects performance  */
 typedef unsigned long (*hshfn)(void *item);
 
+/* a hsh2fn() returns the same as a hashfn(), and puts what the  */
+/* rehashing hashfn() would return in *rehash.  It is for items  */
+/* whose two hashes come out of one pass, see hashtable_new_dual */
+typedef unsigned long (*hsh2fn)(void *item, unsigned long *rehash);
+
 /* A hshcmpfn() compares two items, and returns -ve, 0 (equal), +ve */
 /* corresponding to litem < ritem, litem == ritem, litem > ritem    */
 /* It need only return zero/non-zero if not to be used elsewhere    */
@@ -67,6 +124,12 @@ typedef int  (*hshcmpfn)(void *litem, void *ritem);
 /* provided such modification does NOT affect hshcmpfn              */
 typedef void *(*hshdupfn)(void *item);
 
+/* A hshadupfn() is the hshdupfn of a table made with          */
+/* hashtable_new_arena().  It must take all the space it needs  */
+/* for the copy from the arena a, which is released in one go   */
+/* by hashtable_free(); no hshfreefn is ever called.            */
+typedef void *(*hshadupfn)(void *item, arena *a);
+
 /* A hshfreefn() reverses the action of a hshdupfn.  It is only     */
 /* called during execution of the hshkill() function.  This allows  */
 /* clean-up of memory malloced within the hshdupfn. After execution */
@@ -74,6 +137,14 @@ typedef void *(*hshdupfn)(void *item);
 /* sort demo for an exception.                                      */
 typedef void (*hshfreefn)(void *item);
 
+/* A hshupdfn() is given an item found in the table and the item  */
+/* passed to hashtable_upsert() that compares equal to it.  It      */
+/* returns what the slot is to hold from now on: stored, changed in */
+/* place, or a replacement that hashes and compares the same, in    */
+/* which case stored is the hshupdfn's to free.  NULL is a failure  */
+/* and leaves the slot alone.                                       */
+typedef void *(*hshupdfn)(void *stored, void *item);
+
 /* A hshexecfn() performs some operation on a data item.  It may be */
 /* passed additional data in datum.  It is only used in walking the */
 /* complete stored database. It returns 0 for success.              */
@@ -81,6 +152,11 @@ typedef void (*hshfreefn)(void *item);
 /* During a database walk, the item parameter will never be NULL    */
 typedef int (*hshexecfn)(void *item, void *datum);
 
+/* A hshmergefn() folds the datum one worker of                 */
+/* hashtable_foreach_parallel() filled in into result.  It      */
+/* returns 0 for success.                                       */
+typedef int (*hshmergefn)(void *result, void *datum);
+
 /* ------------ END of auxiliary function types ------------- */
 
 /* Possible error returns, powers of 2 */
@@ -102,18 +178,91 @@ struct hshstats_s {
   hsherr herror;
 };
 
+/* A slot of the HSH_CACHEHASH layout: the stored item, and the */
+/* value hash() returned for it                                 */
+typedef struct hshslot_s hshslot;
+struct hshslot_s {
+  void *item;
+  unsigned long hval;
+};
+
+/* -------------- Optional instrumentation ---------------- */
+/* Turned on by hashtable_instrument(), and read back with       */
+/* hashtable_instr_snapshot().  Costs one pointer test per       */
+/* operation while it is off.                                    */
+
+/* operations with a probe length histogram each */
+#define HSH_OPFIND   0
+#define HSH_OPINSERT 1
+#define HSH_OPREMOVE 2
+#define HSH_NOPS     3
+
+/* hist[op][n] counts operations that looked at n slots.  The    */
+/* last bucket also counts everything longer.                    */
+#define HSH_HISTBUCKETS 32
+
+/* How full the table was at some point.  The load factor is     */
+/* hentries / size and the DELETED ratio hdeleted / size.        */
+typedef struct hshsample_s hshsample;
+struct hshsample_s {
+  unsigned long ops;           /* operations done when it was taken */
+  unsigned long size;
+  unsigned long hentries;
+  unsigned long hdeleted;
+};
+
+/* the most recent samples kept */
+#define HSH_SAMPLES 64
+
+/* The reorganize() times are differences of clock(), which is  */
+/* processor time for the whole process, not wall time for this */
+/* table.  While other threads are busy, shardtable's other     */
+/* shards say, their work is counted in these times too, so     */
+/* they are only exact for a single threaded process.           */
+typedef struct hshinstr_s hshinstr;
+struct hshinstr_s {
+  unsigned long ops;           /* finds, inserts and removes seen */
+  unsigned long hist[HSH_NOPS][HSH_HISTBUCKETS];
+  unsigned long sampleevery;   /* operations between samples */
+  unsigned long nsamples;      /* ever taken; the ring holds the last */
+  hshsample samples[HSH_SAMPLES];  /* sample i is at i % HSH_SAMPLES */
+  unsigned long reorgs;        /* reorganize() runs */
+  double reorgsecs;            /* processor time spent in them */
+  double reorgmax;             /* longest one */
+  double reorglast;            /* most recent one */
+};
+
+/* Where a hashtable_foreach_chunk() scan has got to.  Set it up */
+/* with hashtable_cursor_init().                                 */
+typedef struct hshcursor_s hshcursor;
+struct hshcursor_s {
+  unsigned long pos;           /* next slot to look at */
+  int done;                    /* the scan has covered the table */
+};
+
 /* This is the entity that remembers all about the database  */
 /* It occurs in the users data space, keeping the system     */
 /* reentrant, because it is passed to all entry routines.    */
 typedef struct hashtable_s hashtable;
 struct hashtable_s {
   void **htbl;      /* points to an array of void* */
+  hshslot *hslots;  /* used in place of htbl under HSH_CACHEHASH */
   unsigned long size;          /* size of that array */
+  unsigned int flags;          /* HSH_* layout flags */
+  void **oldhtbl;   /* table being migrated from, HSH_INCREMENTAL */
+  hshslot *oldhslots;
+  unsigned long oldsize;       /* 0 unless a migration is under way */
+  unsigned long migrated;      /* slots of it migrated so far */
+  unsigned int lowwater;       /* % full below which remove shrinks */
   hshfn hash;
   hshfn rehash;
+  hsh2fn hash2;     /* used in place of both, hashtable_new_dual */
   hshcmpfn cmp;
   hshdupfn dupe;
   hshfreefn undupe;
+  hshadupfn adupe;  /* used in place of dupe if there is an harena */
+  arena *harena;    /* where adupe puts items, hashtable_new_arena */
+  hshinstr *hinstr; /* NULL unless instrumented */
   hshstats hstatus;
 };
 
@@ -139,6 +288,86 @@ hashtable *hashtable_new(hshfn hash, hshfn rehash,
 		     hshcmpfn cmp,
 		     hshdupfn dupe, hshfreefn undupe);
 
+/** 
+ * Creates a new hashtable with a non-default table layout. With flags
+ * of 0 this is the same as hashtable_new
+ * 
+ * @param hash the hashing function (faster)
+ * @param rehash a re-hashing function (slower), or NULL with
+ *               HSH_ROBINHOOD
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function
+ * @param flags HSH_* layout flags, or'ed together
+ * 
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+hashtable *hashtable_new_flags(hshfn hash, hshfn rehash,
+			       hshcmpfn cmp,
+			       hshdupfn dupe, hshfreefn undupe,
+			       unsigned int flags);
+
+/** 
+ * Creates a new hashtable that gets both hashes of an item from one
+ * call. Each operation hashes its item once up front, so a probe
+ * that misses does not go back over the item to rehash it
+ * 
+ * @param hash2 the function returning both hashes
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function
+ * @param flags HSH_* layout flags, or'ed together
+ * 
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+hashtable *hashtable_new_dual(hsh2fn hash2,
+			      hshcmpfn cmp,
+			      hshdupfn dupe, hshfreefn undupe,
+			      unsigned int flags);
+
+
+/** 
+ * Creates a new hashtable whose items are copied into an arena of
+ * its own. Bulk loads then cost a bump of a pointer per item instead
+ * of a malloc, and hashtable_free releases the arena a chunk at a
+ * time instead of visiting every item. Items taken out with
+ * hashtable_remove stay in the arena until then, and must not be
+ * freed by the caller
+ * 
+ * @param hash the hashing function (faster)
+ * @param rehash a re-hashing function (slower)
+ * @param cmp a comparator function
+ * @param adupe a duplication function that allocates from the arena
+ * @param chunksize bytes per arena chunk, or 0 for ARENA_CHUNKSIZE
+ * @param flags HSH_* layout flags, or'ed together
+ * 
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+hashtable *hashtable_new_arena(hshfn hash, hshfn rehash,
+			       hshcmpfn cmp, hshadupfn adupe,
+			       size_t chunksize, unsigned int flags);
+
+/** 
+ * Creates a new hashtable already holding n items. The table is
+ * sized for all of them first, so it is never reorganized on the
+ * way, and they go in through hashtable_insert_batch
+ * 
+ * @param hash the hashing function (faster)
+ * @param rehash a re-hashing function (slower)
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function
+ * @param flags HSH_* layout flags, or'ed together
+ * @param items the n items to insert
+ * @param n the number of items
+ * 
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+hashtable *hashtable_new_bulk(hshfn hash, hshfn rehash,
+			      hshcmpfn cmp,
+			      hshdupfn dupe, hshfreefn undupe,
+			      unsigned int flags,
+			      void **items, size_t n);
 
 /** 
  * Frees the memory associated with a hashtable. Will accept NULL
@@ -184,6 +413,93 @@ void *hashtable_remove(hashtable *m, void *item);
  */
 void *hashtable_insert(hashtable *m, void *item);
 
+/** 
+ * Inserts an item, or updates the one equal to it. If none is there
+ * item is inserted as by hashtable_insert, otherwise the slot holding
+ * the equal item is found once and update decides what it holds.
+ * Robin Hood tables walk the probe sequence a second time to insert
+ * 
+ * @param m the hashtable
+ * @param item the item to insert or update from
+ * @param update a hshupdfn
+ * 
+ * @return the address of the stored item, or NULL on failure
+ */
+void *hashtable_upsert(hashtable *m, void *item, hshupdfn update);
+
+/* The _hv functions are hashtable_find, _insert and _remove for a  */
+/* caller that already has item's hash, such as a wrapper that used */
+/* it to pick one of several tables.  hv must be what the table's   */
+/* hash function returns for item.  A hashtable_new_dual table      */
+/* still calls its hsh2fn, for the rehash, and ignores hv.          */
+
+/** 
+ * Locates an item whose hash is known, like hashtable_find
+ * 
+ * @param m the hashtable
+ * @param item the item you are looking for
+ * @param hv the hash of item
+ * 
+ * @return a pointer to the item in the table, or NULL on failure/not
+ *         found
+ */
+void *hashtable_find_hv(hashtable *m, void *item, unsigned long hv);
+
+/** 
+ * Inserts an item whose hash is known, like hashtable_insert
+ * 
+ * @param m the hashtable
+ * @param item the item to insert
+ * @param hv the hash of item
+ * 
+ * @return the address of the item in memory, or NULL on failure
+ */
+void *hashtable_insert_hv(hashtable *m, void *item, unsigned long hv);
+
+/** 
+ * Removes an item whose hash is known, like hashtable_remove
+ * 
+ * @param m the hashtable
+ * @param item the item to remove
+ * @param hv the hash of item
+ * 
+ * @return the address of the item in memory, or NULL on failure/not
+ *         found
+ */
+void *hashtable_remove_hv(hashtable *m, void *item, unsigned long hv);
+
+/** 
+ * Locates many items at once. All of a run of keys are hashed and
+ * their home slots prefetched before any is looked up, so the cache
+ * misses overlap instead of being taken one after another
+ * 
+ * @param m the hashtable
+ * @param items the n items to look for
+ * @param results filled in with what hashtable_find would return
+ *                for each item
+ * @param n the number of items
+ * 
+ * @return the number of items found
+ */
+size_t hashtable_find_batch(hashtable *m, void **items, void **results,
+			    size_t n);
+
+/** 
+ * Inserts many items at once, prefetching like
+ * hashtable_find_batch. The table is grown for all of them before
+ * the first is inserted
+ * 
+ * @param m the hashtable
+ * @param items the n items to insert
+ * @param results filled in with what hashtable_insert would return
+ *                for each item, may be NULL
+ * @param n the number of items
+ * 
+ * @return the number of items stored or already present
+ */
+size_t hashtable_insert_batch(hashtable *m, void **items, void **results,
+			      size_t n);
+
 /* 1------------------1 */
 
 /* apply exec to all entries in table. 0 = success */
@@ -202,6 +518,69 @@ void *hashtable_insert(hashtable *m, void *item);
  */
 int hashtable_foreach(hashtable *m, hshexecfn exec, void *datum);
 
+/** 
+ * Executes exec for each item, splitting the table into nthreads
+ * runs of slots each walked by its own thread with its own datum.
+ * exec must therefore only touch its datum and the item. Once every
+ * run is done, merge (if not NULL) is called on result with each
+ * datum in turn. The table must not be changed meanwhile
+ * 
+ * @param m the hashtable
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure, which stops every thread
+ * @param datums nthreads data areas, one for each thread
+ * @param nthreads the number of threads, the caller being one
+ * @param merge a merge fn, or NULL
+ * @param result passed to merge
+ * 
+ * @return 0 on success, other on failure
+ */
+int hashtable_foreach_parallel(hashtable *m, hshexecfn exec,
+			       void **datums, unsigned int nthreads,
+			       hshmergefn merge, void *result);
+
+/** 
+ * Starts a cursor at the beginning of a table
+ * 
+ * @param c the cursor
+ */
+void hashtable_cursor_init(hshcursor *c);
+
+/** 
+ * Executes exec for the items in the next maxslots slots of a
+ * scan, so a long scan can be done a bounded piece at a time,
+ * changing the table in between. Items there for the whole scan are
+ * seen exactly once, unless the table is reorganized or migrated,
+ * or a Robin Hood remove shifts them back past the cursor, between
+ * chunks; then they may be missed or seen twice
+ * 
+ * @param m the hashtable
+ * @param c the cursor, c->done is set when the scan is finished
+ * @param maxslots the most slots to look at, at least 1
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure, after which the scan can carry on
+ * @param datum data that the exec function will have access to.
+ * 
+ * @return 0 on success, other on failure or if maxslots is 0, which
+ *         would leave the cursor where it is
+ */
+int hashtable_foreach_chunk(hashtable *m, hshcursor *c,
+			    unsigned long maxslots,
+			    hshexecfn exec, void *datum);
+
+
+/** 
+ * Grows the table, in one step, so that n more items can be inserted
+ * without it being reorganized. Does nothing if there is room
+ * already
+ * 
+ * @param m the hashtable
+ * @param n the number of items to make room for
+ * 
+ * @return 0 on success, other on failure, when the table is left as
+ *         it was
+ */
+int hashtable_reserve(hashtable *m, unsigned long n);
 
 /** 
  * Return statistics for this hashtable
@@ -212,6 +591,57 @@ int hashtable_foreach(hashtable *m, hshexecfn exec, void *datum);
  */
 hshstats *hashtable_stats(hashtable *m);
 
+/** 
+ * Sets the low-water mark below which hashtable_remove shrinks the
+ * table. When fewer than lowwater percent of the slots hold items,
+ * the table is rebuilt at the smallest size that leaves it no more
+ * than about half full. Tables start with a mark of 0, never
+ * shrinking
+ * 
+ * @param m the hashtable
+ * @param lowwater the mark in percent, 0 to HASHTABLE_MAXLOWWATER
+ * 
+ * @return 0 on success, other on failure
+ */
+int hashtable_shrink_policy(hashtable *m, unsigned int lowwater);
+
+/** 
+ * Rebuilds the table at the smallest size that holds what is in it,
+ * giving back the memory of a table that has had many items
+ * removed. DELETED slots go too, and any migration is finished.
+ * Call hashtable_reserve afterwards to leave room for more
+ * 
+ * @param m the hashtable
+ * 
+ * @return 0 on success, other on failure
+ */
+int hashtable_compact(hashtable *m);
+
+/** 
+ * Starts, restarts or stops recording probe length histograms,
+ * samples of the load and DELETED ratio, and reorganize() times.
+ * Restarting clears what was recorded
+ * 
+ * @param m the hashtable
+ * @param sampleevery take a load sample after this many operations
+ *                    (a sample is also taken after each reorganize),
+ *                    or 0 to stop recording
+ * 
+ * @return 0 on success, other on failure
+ */
+int hashtable_instrument(hashtable *m, unsigned long sampleevery);
+
+/** 
+ * Copies out what has been recorded so far. The table carries on
+ * recording
+ * 
+ * @param m the hashtable
+ * @param snap where to put the copy
+ * 
+ * @return 0 on success, other if the table is not instrumented
+ */
+int hashtable_instr_snapshot(hashtable *m, hshinstr *snap);
+
 /* ============= Useful generic functions ============= */
 
 /** 
@@ -233,5 +663,16 @@ unsigned long hshstrhash(const char * string);
  */
 unsigned long hshstrehash(const char * string);
 
+/** 
+ * Mixes a hash value so that every input bit affects the low bits
+ * of the result. HSH_POW2 tables index by masking its output, so
+ * weak low bits out of hash() do not pile items into a few slots
+ * 
+ * @param hv the value returned by a hshfn
+ * 
+ * @return the mixed value
+ */
+unsigned long hshmix(unsigned long hv);
+
 #endif /* _HASHTABLE_H_ */
 
@@ -0,0 +1,239 @@
+/**
+ * @file   hashtable_tmpl.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 18:12:06 2026
+ * 
+ * @brief A type specialised hash map, generated per key and value
+ * type by a macro. Keys and values are stored in the slots, and hash
+ * and compare are called directly rather than through a function
+ * pointer on a void *, so the compiler can inline them into the
+ * probe loop.
+ * 
+ * 
+ */
+
+#ifndef _HASHTABLE_TMPL_H_
+#define _HASHTABLE_TMPL_H_
+
+#include <stdlib.h>
+
+#include "hashtable.h"
+
+/* HASHTABLE_DECLARE(name, K, V, hashfn, eqfn) defines the types   */
+/* name and name_slot, and static functions                        */
+/*                                                                 */
+/*   name *name_new(void);                                         */
+/*   void  name_free(name *t);                                     */
+/*   V    *name_find(name *t, K key);                              */
+/*   V    *name_insert(name *t, K key, V value);                   */
+/*   int   name_remove(name *t, K key, V *value);                  */
+/*                                                                 */
+/* in the file that uses it.  hashfn(key) returns an unsigned long */
+/* and eqfn(a, b) is non-zero when two keys are equal; both may be */
+/* macros.  Keys and values are copied in by assignment, and       */
+/* nothing is freed but the table itself.  A returned V * is good  */
+/* until the next insert.                                          */
+/*                                                                 */
+/* Probing is the double hashing of an HSH_POW2 | HSH_CACHEHASH    */
+/* hashtable: hshmix() picks the home slot, and the full hash is   */
+/* kept in each slot.  There is no rehash function; the odd step   */
+/* is taken from other bits of the hash.  Walk the table with      */
+/*                                                                 */
+/*   for (i = 0; i < t->size; i++)                                 */
+/*     if (t->slots[i].state == HSHT_FULL) ...                     */
+
+#define HSHT_EMPTY   0
+#define HSHT_FULL    1
+#define HSHT_DELETED 2
+
+/* Threshold of used slots above which the table is rebuilt */
+#define HSHT_THRESH(sz) ((sz) - ((sz) >> 3))
+
+/* The double hashing step for hv in a table of sz slots */
+#define HSHT_STEP(hv, sz) ((hshmix((hv) ^ 0x5bd1e995UL)		\
+			    & (((sz) >> 3) - 1)) | 1)
+
+/* Instances rarely use every function */
+#ifdef __GNUC__
+#define HSHT_UNUSED __attribute__((unused))
+#else
+#define HSHT_UNUSED
+#endif
+
+#define HASHTABLE_DECLARE(name, K, V, hashfn, eqfn)                     \
+typedef struct name##_slot_s name##_slot;                               \
+struct name##_slot_s {                                                  \
+  K key;                                                                \
+  V value;                                                              \
+  unsigned long hval;                                                   \
+  unsigned char state;         /* HSHT_EMPTY, _FULL or _DELETED */     \
+};                                                                      \
+                                                                        \
+typedef struct name##_s name;                                           \
+struct name##_s {                                                       \
+  name##_slot *slots;                                                   \
+  unsigned long size;          /* a power of 2 */                       \
+  unsigned long used;          /* full and DELETED slots */             \
+  unsigned long count;         /* full slots */                         \
+};                                                                      \
+                                                                        \
+HSHT_UNUSED static name *name##_new(void)                               \
+{                                                                       \
+  name *t;                                                              \
+                                                                        \
+  t = calloc(1, sizeof(*t));                                            \
+  if(t == NULL) {                                                       \
+    return NULL;                                                        \
+  }                                                                     \
+                                                                        \
+  t->slots = calloc(HASHTABLE_POW2STARTSIZE, sizeof(*(t->slots)));      \
+  if(t->slots == NULL) {                                                \
+    free(t);                                                            \
+    return NULL;                                                        \
+  }                                                                     \
+  t->size = HASHTABLE_POW2STARTSIZE;                                    \
+                                                                        \
+  return t;                                                             \
+}                                                                       \
+                                                                        \
+HSHT_UNUSED static void name##_free(name *t)                            \
+{                                                                       \
+  if(t == NULL) {                                                       \
+    return;                                                             \
+  }                                                                     \
+                                                                        \
+  free(t->slots);                                                       \
+  free(t);                                                              \
+}                                                                       \
+                                                                        \
+/* the slot holding key, or size */                                     \
+HSHT_UNUSED static unsigned long name##_locate(name *t, K key,          \
+                                                unsigned long hv)       \
+{                                                                       \
+  unsigned long h, step, mask;                                          \
+                                                                        \
+  mask = t->size - 1;                                                   \
+  h = hshmix(hv) & mask;                                                \
+  step = 0;                                                             \
+                                                                        \
+  while(t->slots[h].state != HSHT_EMPTY) {                              \
+    if((t->slots[h].state == HSHT_FULL) &&                              \
+       (t->slots[h].hval == hv) &&                                      \
+       eqfn(t->slots[h].key, key)) {                                    \
+      return h;                                                         \
+    }                                                                   \
+    if(step == 0) {                                                     \
+      step = HSHT_STEP(hv, t->size);                                    \
+    }                                                                   \
+    h = (h + step) & mask;                                              \
+  }                                                                     \
+                                                                        \
+  return t->size;                                                       \
+}                                                                       \
+                                                                        \
+/* Rebuild into a table sized so count is under half the threshold */   \
+HSHT_UNUSED static int name##_grow(name *t)                             \
+{                                                                       \
+  name##_slot *old;                                                     \
+  unsigned long oldsize, newsize, i, h, step, mask;                     \
+                                                                        \
+  newsize = t->size;                                                    \
+  while(HSHT_THRESH(newsize) / 2 < t->count + 1) {                      \
+    if((newsize << 1) < newsize) {                                      \
+      return 0;                                                         \
+    }                                                                   \
+    newsize <<= 1;                                                      \
+  }                                                                     \
+                                                                        \
+  old = t->slots;                                                       \
+  oldsize = t->size;                                                    \
+  t->slots = calloc(newsize, sizeof(*(t->slots)));                      \
+  if(t->slots == NULL) {                                                \
+    t->slots = old;                                                     \
+    return 0;                                                           \
+  }                                                                     \
+  t->size = newsize;                                                    \
+  t->used = t->count;                                                   \
+                                                                        \
+  mask = newsize - 1;                                                   \
+  for(i = 0; i < oldsize; i++) {                                        \
+    if(old[i].state != HSHT_FULL) {                                     \
+      continue;                                                         \
+    }                                                                   \
+    h = hshmix(old[i].hval) & mask;                                     \
+    step = HSHT_STEP(old[i].hval, newsize);                             \
+    while(t->slots[h].state != HSHT_EMPTY) {                            \
+      h = (h + step) & mask;                                            \
+    }                                                                   \
+    t->slots[h] = old[i];                                               \
+  }                                                                     \
+                                                                        \
+  free(old);                                                            \
+  return 1;                                                             \
+}                                                                       \
+                                                                        \
+/* Returns the stored value for key, or NULL */                         \
+HSHT_UNUSED static V *name##_find(name *t, K key)                       \
+{                                                                       \
+  unsigned long h;                                                      \
+                                                                        \
+  h = name##_locate(t, key, hashfn(key));                               \
+  return (h < t->size) ? &t->slots[h].value : NULL;                     \
+}                                                                       \
+                                                                        \
+/* Stores value under key, unless key is there already, and */          \
+/* returns the stored value, or NULL if out of memory       */          \
+HSHT_UNUSED static V *name##_insert(name *t, K key, V value)            \
+{                                                                       \
+  unsigned long h, hv, step, mask;                                      \
+                                                                        \
+  hv = hashfn(key);                                                     \
+  h = name##_locate(t, key, hv);                                        \
+  if(h < t->size) {                                                     \
+    return &t->slots[h].value;                                          \
+  }                                                                     \
+                                                                        \
+  if((t->used >= HSHT_THRESH(t->size)) && !name##_grow(t)) {            \
+    return NULL;                                                        \
+  }                                                                     \
+                                                                        \
+  mask = t->size - 1;                                                   \
+  h = hshmix(hv) & mask;                                                \
+  step = HSHT_STEP(hv, t->size);                                        \
+  while(t->slots[h].state == HSHT_FULL) {                               \
+    h = (h + step) & mask;                                              \
+  }                                                                     \
+                                                                        \
+  if(t->slots[h].state == HSHT_EMPTY) {                                 \
+    t->used++;                                                          \
+  }                                                                     \
+  t->slots[h].key = key;                                                \
+  t->slots[h].value = value;                                            \
+  t->slots[h].hval = hv;                                                \
+  t->slots[h].state = HSHT_FULL;                                        \
+  t->count++;                                                           \
+                                                                        \
+  return &t->slots[h].value;                                            \
+}                                                                       \
+                                                                        \
+/* Removes key, copying its value out to *value if that is not */       \
+/* NULL.  Returns 1 if it was there, else 0                    */       \
+HSHT_UNUSED static int name##_remove(name *t, K key, V *value)          \
+{                                                                       \
+  unsigned long h;                                                      \
+                                                                        \
+  h = name##_locate(t, key, hashfn(key));                               \
+  if(h >= t->size) {                                                    \
+    return 0;                                                           \
+  }                                                                     \
+                                                                        \
+  if(value != NULL) {                                                   \
+    *value = t->slots[h].value;                                         \
+  }                                                                     \
+  t->slots[h].state = HSHT_DELETED;                                     \
+  t->count--;                                                           \
+                                                                        \
+  return 1;                                                             \
+}
+
+#endif /* _HASHTABLE_TMPL_H_ */
@@ -0,0 +1,249 @@
+/**
+ * @file   intern.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 18:02:37 2026
+ *
+ * @brief  A string interning pool. More documentation in intern.h
+ *
+ *
+ */
+
+#include "intern.h"
+#include "hash.h"
+
+/**
+ * Private functions
+ *
+ */
+static unsigned long in_hash(void *is);
+static int in_cmp(void *a, void *b);
+static intern_str *in_alloc(intern *p, size_t need);
+static unsigned int classof(size_t n);
+
+/* The header of an interned string */
+#define HEADER(s) (((intern_str*)(s)) - 1)
+
+/* Bytes in a block of class c: 2**(c/4) times 1, 1.25, 1.5 or 1.75 */
+#define CLASSSIZE(c) ((((size_t)4 + (c) % 4) << ((c) / 4)) >> 2)
+
+
+intern *intern_new(size_t chunksize)
+{
+  intern *p;
+  unsigned int c;
+
+  p = calloc(1, sizeof(*p));
+  if(p == NULL) {
+    return NULL;
+  }
+
+  /* Robin Hood tables cache the hash and need no rehash, and */
+  /* their removes leave no DELETED slots behind              */
+  p->strings = hashtable_new_flags(in_hash, NULL, in_cmp, NULL, NULL,
+				   HSH_ROBINHOOD);
+  p->store = arena_new(chunksize);
+  if((p->strings == NULL) ||
+     (p->store == NULL)) {
+    hashtable_free(p->strings);
+    arena_free(p->store);
+    free(p);
+    return NULL;
+  }
+
+  for(c = 0; c < INTERN_CLASSES; c++) {
+    p->freelists[c] = NULL;
+  }
+
+  return p;
+}
+
+void intern_free(intern *p)
+{
+  if(p == NULL) {
+    return;
+  }
+
+  /* the strings themselves all go with the arena */
+  hashtable_free(p->strings);
+  arena_free(p->store);
+  free(p);
+}
+
+const char *intern_string(intern *p, const char *s)
+{
+  if(s == NULL) {
+    return NULL;
+  }
+
+  return intern_string_n(p, s, strlen(s));
+}
+
+const char *intern_string_n(intern *p, const char *s, size_t len)
+{
+  intern_str probe, *is;
+  unsigned long hv;
+  char *copy;
+
+  if((p == NULL) ||
+     (s == NULL)) {
+    return NULL;
+  }
+
+  probe.u.str = s;
+  probe.len = len;
+
+  /* hashed once for both the find and, on a miss, the insert */
+  hv = in_hash(&probe);
+  is = hashtable_find_hv(p->strings, &probe, hv);
+  if(is != NULL) {
+    is->refs++;
+    return is->u.str;
+  }
+
+  if(len > ((size_t)-1) - sizeof(*is) - 1) {
+    return NULL;
+  }
+
+  is = in_alloc(p, sizeof(*is) + len + 1);
+  if(is == NULL) {
+    return NULL;
+  }
+
+  copy = (char*)(is + 1);
+  memcpy(copy, s, len);
+  copy[len] = '\0';
+  is->u.str = copy;
+  is->len = len;
+  is->refs = 1;
+
+  if(hashtable_insert_hv(p->strings, is, hv) == NULL) {
+    intern_release(p, copy);
+    return NULL;
+  }
+
+  return copy;
+}
+
+const char *intern_lookup(intern *p, const char *s, size_t len)
+{
+  intern_str probe, *is;
+
+  if((p == NULL) ||
+     (s == NULL)) {
+    return NULL;
+  }
+
+  probe.u.str = s;
+  probe.len = len;
+
+  is = hashtable_find(p->strings, &probe);
+  return (is == NULL) ? NULL : is->u.str;
+}
+
+void intern_release(intern *p, const char *s)
+{
+  intern_str *is;
+  unsigned int c;
+
+  if((p == NULL) ||
+     (s == NULL)) {
+    return;
+  }
+
+  is = HEADER(s);
+  if(--is->refs > 0) {
+    return;
+  }
+
+  /* not there if this is undoing a failed insert */
+  (void) hashtable_remove(p->strings, is);
+
+  c = classof(is->cap);
+  if(c < INTERN_CLASSES) {
+    is->u.next = p->freelists[c];
+    p->freelists[c] = is;
+  }
+}
+
+size_t intern_length(const char *s)
+{
+  return HEADER(s)->len;
+}
+
+unsigned long intern_count(intern *p)
+{
+  if(p == NULL) {
+    return 0;
+  }
+
+  /* Robin Hood removes take entries straight off the count */
+  return hashtable_stats(p->strings)->hentries;
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+static unsigned long in_hash(void *is)
+{
+  return (unsigned long)hash_string64_n( ((intern_str*)is)->u.str,
+					 ((intern_str*)is)->len );
+}
+
+/* the hashtable only asks whether two items are equal */
+static int in_cmp(void *a, void *b)
+{
+  intern_str *l, *r;
+
+  l = (intern_str*)a;
+  r = (intern_str*)b;
+
+  if(l->len != r->len) {
+    return 1;
+  }
+
+  return memcmp(l->u.str, r->u.str, l->len);
+}
+
+/* A block of at least need bytes, rounded up to its size  */
+/* class.  A released block of the class is reused if there */
+/* is one, else a new one comes from the arena.  Returns    */
+/* NULL if out of memory.                                   */
+static intern_str *in_alloc(intern *p, size_t need)
+{
+  intern_str *is;
+  unsigned int c;
+
+  c = classof(need);
+  if(c < INTERN_CLASSES) {
+    if(p->freelists[c] != NULL) {
+      is = p->freelists[c];
+      p->freelists[c] = is->u.next;
+      return is;
+    }
+    need = CLASSSIZE(c);
+  }
+
+  is = arena_alloc(p->store, need);
+  if(is == NULL) {
+    return NULL;
+  }
+
+  is->cap = need;
+  return is;
+}
+
+/* The smallest class whose blocks hold n bytes, or */
+/* INTERN_CLASSES if n is too big for any           */
+static unsigned int classof(size_t n)
+{
+  unsigned int c;
+
+  for(c = 0; (c < INTERN_CLASSES) && (CLASSSIZE(c) < n); c++) {
+    /* empty */
+  }
+
+  return c;
+}
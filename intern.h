@@ -0,0 +1,130 @@
+/**
+ * @file   intern.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 17:48:05 2026
+ *
+ * @brief A string interning pool. Every distinct string interned
+ * gets one canonical copy, so equal strings share their memory and
+ * two interned strings are equal exactly when their pointers are.
+ *
+ *
+ */
+
+#ifndef _INTERN_H_
+#define _INTERN_H_
+
+#include <stdlib.h>
+
+#include "hashtable.h"
+#include "arena.h"
+
+/* Copies are carved out of an arena, each behind a small header   */
+/* holding its length and a count of the intern calls that have    */
+/* not yet been matched by intern_release.  When that count drops  */
+/* to 0 the string leaves the table and its block goes on a free   */
+/* list, to be reused by a later string that fits in it; the arena */
+/* itself only ever grows.  A pool is not safe to share between    */
+/* threads without a lock around it.                               */
+
+/* Blocks come in size classes, four to each power of 2, so one is */
+/* never more than a quarter bigger than asked for.  Anything too  */
+/* big for the last class is never reused.                         */
+#define INTERN_CLASSES (4 * (sizeof(size_t) * 8 - 3))
+
+typedef struct intern_str_s intern_str;
+struct intern_str_s {
+  union {
+    const char *str;       /* the string, straight after the header */
+    intern_str *next;      /* next on a free list, once released */
+  } u;
+  size_t len;
+  size_t cap;              /* bytes in the block, header included */
+  unsigned long refs;
+};
+
+typedef struct intern_s intern;
+struct intern_s {
+  hashtable *strings;      /* of intern_str, HSH_ROBINHOOD */
+  arena *store;
+  intern_str *freelists[INTERN_CLASSES];
+};
+
+/**
+ * Creates a new, empty pool
+ *
+ * @param chunksize bytes per arena chunk, or 0 for ARENA_CHUNKSIZE
+ *
+ * @return the pool, or NULL on failure
+ */
+intern *intern_new(size_t chunksize);
+
+/**
+ * Frees a pool and every string in it, released or not. Will accept
+ * NULL gracefully
+ *
+ * @param p the pool
+ */
+void intern_free(intern *p);
+
+/**
+ * Interns a string
+ *
+ * @param p the pool
+ * @param s the string
+ *
+ * @return the canonical copy of s, which stays valid until it has
+ *         been released as many times as it was interned, or NULL on
+ *         failure
+ */
+const char *intern_string(intern *p, const char *s);
+
+/**
+ * Interns len bytes, which need not be terminated. The copy is
+ * given a '\0' after them
+ *
+ * @param p the pool
+ * @param s the bytes
+ * @param len how many
+ *
+ * @return the canonical copy, or NULL on failure
+ */
+const char *intern_string_n(intern *p, const char *s, size_t len);
+
+/**
+ * Finds the canonical copy of a string without interning it
+ *
+ * @param p the pool
+ * @param s the bytes
+ * @param len how many
+ *
+ * @return the canonical copy, or NULL if it is not in the pool
+ */
+const char *intern_lookup(intern *p, const char *s, size_t len);
+
+/**
+ * Gives up one reference to an interned string
+ *
+ * @param p the pool
+ * @param s a pointer returned by intern_string or intern_string_n
+ */
+void intern_release(intern *p, const char *s);
+
+/**
+ * The length of an interned string, without scanning it
+ *
+ * @param s a pointer returned by intern_string or intern_string_n
+ *
+ * @return its length
+ */
+size_t intern_length(const char *s);
+
+/**
+ * The number of distinct strings in the pool
+ *
+ * @param p the pool
+ *
+ * @return the number of strings
+ */
+unsigned long intern_count(intern *p);
+
+#endif /* _INTERN_H_ */
@@ -0,0 +1,246 @@
+/**
+ * @file   shardtable.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 17:02:44 2026
+ *
+ * @brief  A hash map split into independently locked shards. More
+ * documentation in shardtable.h
+ *
+ *
+ */
+
+#include <limits.h>
+
+#include "shardtable.h"
+
+/**
+ * Private functions
+ *
+ */
+static shard *shardof(shardtable *m, unsigned long hv);
+
+/* bits in the value shards are picked from */
+#define HBITS (sizeof(unsigned long) * CHAR_BIT)
+
+
+shardtable *shardtable_new(hshfn hash, hshfn rehash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe,
+			   unsigned int nshards, unsigned int flags)
+{
+  shardtable *m;
+  unsigned int i, bits;
+
+  if((hash == NULL) ||
+     (cmp == NULL)) {
+    return NULL;
+  }
+
+  if(nshards == 0) {
+    nshards = SHARDTABLE_SHARDS;
+  }
+
+  /* round up to a power of 2, counting the bits it takes */
+  for(bits = 0; (1UL << bits) < nshards; bits++) {
+    if(bits + 1 >= HBITS) {
+      return NULL;
+    }
+  }
+
+  m = calloc(1, sizeof(*m));
+  if(m == NULL) {
+    return NULL;
+  }
+
+  m->nshards = 1U << bits;
+  m->shift = HBITS - bits;
+  m->hash = hash;
+
+  m->shards = calloc(m->nshards, sizeof(*m->shards));
+  if(m->shards == NULL) {
+    free(m);
+    return NULL;
+  }
+
+  for(i = 0; i < m->nshards; i++) {
+    m->shards[i].tbl = hashtable_new_flags(hash, rehash, cmp,
+					   dupe, undupe, flags);
+    if((m->shards[i].tbl == NULL) ||
+       (pthread_mutex_init(&m->shards[i].lock, NULL) != 0)) {
+      hashtable_free(m->shards[i].tbl);
+      break;
+    }
+  }
+
+  if(i < m->nshards) {
+    /* undo the shards that were made */
+    m->nshards = i;
+    shardtable_free(m);
+    return NULL;
+  }
+
+  return m;
+}
+
+void shardtable_free(shardtable *m)
+{
+  unsigned int i;
+
+  if(m == NULL) {
+    return;
+  }
+
+  for(i = 0; i < m->nshards; i++) {
+    hashtable_free(m->shards[i].tbl);
+    pthread_mutex_destroy(&m->shards[i].lock);
+  }
+
+  free(m->shards);
+  free(m);
+}
+
+void *shardtable_find(shardtable *m, void *item)
+{
+  shard *s;
+  unsigned long hv;
+  void *found;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = m->hash(item);
+  s = shardof(m, hv);
+  pthread_mutex_lock(&s->lock);
+  found = hashtable_find_hv(s->tbl, item, hv);
+  pthread_mutex_unlock(&s->lock);
+
+  return found;
+}
+
+void *shardtable_insert(shardtable *m, void *item)
+{
+  shard *s;
+  unsigned long hv;
+  void *stored;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = m->hash(item);
+  s = shardof(m, hv);
+  pthread_mutex_lock(&s->lock);
+  stored = hashtable_insert_hv(s->tbl, item, hv);
+  pthread_mutex_unlock(&s->lock);
+
+  return stored;
+}
+
+void *shardtable_remove(shardtable *m, void *item)
+{
+  shard *s;
+  unsigned long hv;
+  void *olditem;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = m->hash(item);
+  s = shardof(m, hv);
+  pthread_mutex_lock(&s->lock);
+  olditem = hashtable_remove_hv(s->tbl, item, hv);
+  pthread_mutex_unlock(&s->lock);
+
+  return olditem;
+}
+
+int shardtable_apply(shardtable *m, void *item,
+		     hshexecfn exec, void *datum)
+{
+  shard *s;
+  unsigned long hv;
+  void *stored;
+  int err;
+
+  if((m == NULL) ||
+     (exec == NULL)) {
+    return -1;
+  }
+
+  hv = m->hash(item);
+  s = shardof(m, hv);
+  pthread_mutex_lock(&s->lock);
+  stored = hashtable_insert_hv(s->tbl, item, hv);
+  err = (stored == NULL) ? -1 : exec(stored, datum);
+  pthread_mutex_unlock(&s->lock);
+
+  return err;
+}
+
+int shardtable_foreach(shardtable *m, hshexecfn exec, void *datum)
+{
+  unsigned int i;
+  int err;
+
+  if((m == NULL) ||
+     (exec == NULL)) {
+    return -1;
+  }
+
+  for(i = 0; i < m->nshards; i++) {
+    pthread_mutex_lock(&m->shards[i].lock);
+    err = hashtable_foreach(m->shards[i].tbl, exec, datum);
+    pthread_mutex_unlock(&m->shards[i].lock);
+    if(err != 0) {
+      return err;
+    }
+  }
+
+  return 0;
+}
+
+void shardtable_stats(shardtable *m, hshstats *stats)
+{
+  hshstats *st;
+  unsigned int i;
+
+  if((m == NULL) ||
+     (stats == NULL)) {
+    return;
+  }
+
+  stats->probes = stats->misses = 0;
+  stats->hentries = 0;
+  stats->hdeleted = 0;
+  stats->herror = hshOK;
+
+  for(i = 0; i < m->nshards; i++) {
+    pthread_mutex_lock(&m->shards[i].lock);
+    st = hashtable_stats(m->shards[i].tbl);
+    stats->probes += st->probes;
+    stats->misses += st->misses;
+    stats->hentries += st->hentries;
+    stats->hdeleted += st->hdeleted;
+    stats->herror |= st->herror;
+    pthread_mutex_unlock(&m->shards[i].lock);
+  }
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* The shard for an item of hash hv.  With one shard the shift */
+/* would be the full width of the word, which C leaves         */
+/* undefined.                                                  */
+static shard *shardof(shardtable *m, unsigned long hv)
+{
+  if(m->nshards == 1) {
+    return m->shards;
+  }
+
+  return m->shards + (hshmix(hv) >> m->shift);
+}
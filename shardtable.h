@@ -0,0 +1,158 @@
+/**
+ * @file   shardtable.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 16:53:10 2026
+ *
+ * @brief A hash map split into shards, each an ordinary hashtable
+ * behind a mutex of its own, so that threads writing different keys
+ * mostly take different locks. Uses the same item callbacks as
+ * hashtable.
+ *
+ *
+ */
+
+#ifndef _SHARDTABLE_H_
+#define _SHARDTABLE_H_
+
+#include <pthread.h>
+
+#include "hashtable.h"
+
+/* An item goes to the shard picked by the top bits of              */
+/* hshmix(hash(item)).  HSH_POW2 tables index by the low bits of    */
+/* the same value, so the shard choice does not thin out the slots  */
+/* an item can land in.  Every shard grows (reorganize()s) on its   */
+/* own, holding only its own lock, so a shard being rebuilt does    */
+/* not hold up writers to the others.  The hash that picks the      */
+/* shard is handed on to the shard's table, so an item is hashed    */
+/* once an operation.                                               */
+
+/* shards used when shardtable_new is given 0 */
+#define SHARDTABLE_SHARDS 16
+
+/* bytes a shard is padded with, so that the locks of two shards */
+/* are never on the same cache line                              */
+#define SHARDTABLE_PAD 64
+
+typedef struct shard_s shard;
+struct shard_s {
+  pthread_mutex_t lock;
+  hashtable *tbl;
+  char pad[SHARDTABLE_PAD];
+};
+
+typedef struct shardtable_s shardtable;
+struct shardtable_s {
+  shard *shards;
+  unsigned int nshards;      /* a power of 2 */
+  unsigned int shift;        /* hshmix() >> shift is the shard */
+  hshfn hash;
+};
+
+/**
+ * Creates a new sharded hashtable, returns a pointer to it, or NULL
+ * on failure
+ *
+ * @param hash the hashing function (faster)
+ * @param rehash a re-hashing function (slower), or NULL with
+ *               HSH_ROBINHOOD
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function
+ * @param nshards the number of shards, rounded up to a power of 2,
+ *                or 0 for SHARDTABLE_SHARDS
+ * @param flags HSH_* layout flags for every shard, or'ed together
+ *
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+shardtable *shardtable_new(hshfn hash, hshfn rehash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe,
+			   unsigned int nshards, unsigned int flags);
+
+/**
+ * Frees a sharded hashtable and every item in it. No other thread
+ * may be using it. Will accept NULL gracefully
+ *
+ * @param m the hashtable
+ */
+void shardtable_free(shardtable *m);
+
+/**
+ * Locates an item in the hashtable. The item may be removed by
+ * another thread as soon as this returns, so the pointer is only
+ * safe to use if items are never removed, or through shardtable_apply
+ *
+ * @param m the hashtable
+ * @param item the item you are looking for
+ *
+ * @return a pointer to the item in the table, or NULL on failure/not
+ *         found
+ */
+void *shardtable_find(shardtable *m, void *item);
+
+/**
+ * Insert an item into the hashtable, unless an equal one is there
+ * already
+ *
+ * @param m the hashtable
+ * @param item the item to insert
+ *
+ * @return the address of the stored item, or NULL on failure
+ */
+void *shardtable_insert(shardtable *m, void *item);
+
+/**
+ * Removes an item. As with hashtable_remove, the caller is then
+ * responsible for freeing it
+ *
+ * @param m the hashtable
+ * @param item the item to remove
+ *
+ * @return the address of the item in memory, or NULL on failure/not
+ *         found
+ */
+void *shardtable_remove(shardtable *m, void *item);
+
+/**
+ * Inserts an item unless an equal one is there already, then runs
+ * exec on the stored item while still holding its shard's lock, so
+ * that exec can change it (bump a counter, say) without racing
+ * other writers of the same key. exec must not call back into the
+ * table
+ *
+ * @param m the hashtable
+ * @param item the item to insert
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure
+ * @param datum data that the exec function will have access to.
+ *
+ * @return what exec returned, or -1 if the item could not be stored
+ */
+int shardtable_apply(shardtable *m, void *item,
+		     hshexecfn exec, void *datum);
+
+/**
+ * Executes exec for each item in the table (no guaranteed order).
+ * Shards are locked one at a time, so it sees each shard as it was
+ * at some moment, but not all of them at the same one. exec must
+ * not call back into the table
+ *
+ * @param m the hashtable
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure
+ * @param datum data that the exec function will have access to.
+ *
+ * @return 0 on success, other on failure
+ */
+int shardtable_foreach(shardtable *m, hshexecfn exec, void *datum);
+
+/**
+ * Adds up the statistics of every shard. herror is the or of all
+ * of theirs
+ *
+ * @param m the hashtable
+ * @param stats where to put them
+ */
+void shardtable_stats(shardtable *m, hshstats *stats);
+
+#endif /* _SHARDTABLE_H_ */
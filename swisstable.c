@@ -0,0 +1,390 @@
+/**
+ * @file   swisstable.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 13:40:19 2026
+ *
+ * @brief  A group probing hash map. More documentation in
+ * swisstable.h
+ *
+ *
+ */
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "swisstable.h"
+
+/**
+ * Private functions
+ *
+ */
+static unsigned int matchbyte(const unsigned char *group, unsigned char b);
+static unsigned int matchfree(const unsigned char *group);
+static unsigned int firstbit(unsigned int mask);
+static unsigned long locate(swisstable *m, void *item, unsigned long hv);
+static unsigned long freeslot(swisstable *m, unsigned long hv);
+static int rebuild(swisstable *m);
+static int newtbl(swisstable *m, unsigned long size);
+
+/* Threshold of used slots above which the table is rebuilt */
+#define TTHRESH(sz) (sz - (sz >> 3))
+
+/* The control byte kept for a mixed hash, and its first group */
+#define H2(mh) ((unsigned char)((mh) & 0x7f))
+#define H1(mh) ((mh) >> 7)
+
+
+swisstable *swisstable_new(hshfn hash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe)
+{
+  swisstable *m;
+
+  if((hash == NULL) ||
+     (cmp == NULL)) {
+    return NULL;
+  }
+
+  m = calloc(1, sizeof(*m));
+  if(m == NULL) {
+    return NULL;
+  }
+
+  if(!newtbl(m, SWISSTABLE_GROUP)) {
+    free(m);
+    return NULL;
+  }
+
+  m->hash = hash;
+  m->cmp = cmp;
+  m->dupe = dupe;
+  m->undupe = undupe;
+
+  /* initialise the status portion */
+  m->hstatus.probes = m->hstatus.misses = 0;
+  m->hstatus.hentries = 0;
+  m->hstatus.hdeleted = 0;
+  m->hstatus.herror = hshOK;
+
+  return m;
+}
+
+void swisstable_free(swisstable *m)
+{
+  unsigned long i;
+
+  if(m == NULL) {
+    return;
+  }
+
+  for(i = 0; i < m->size; i++) {
+    if(!(m->ctrl[i] & 0x80) &&
+       (m->undupe != NULL)) {
+      m->undupe(m->items[i]);
+    }
+  }
+
+  free(m->ctrl);
+  free(m->items);
+  free(m);
+}
+
+void *swisstable_find(swisstable *m, void *item)
+{
+  unsigned long h;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  h = locate(m, item, m->hash(item));
+  return (h < m->size) ? m->items[h] : NULL;
+}
+
+void *swisstable_insert(swisstable *m, void *item)
+{
+  unsigned long h, hv;
+  void *stored;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  hv = m->hash(item);
+  h = locate(m, item, hv);
+  if(h < m->size) {
+    /* found already inserted here */
+    return m->items[h];
+  }
+
+  if((m->used >= TTHRESH(m->size)) && !rebuild(m)) {
+    m->hstatus.herror |= hshTBLFULL;
+    return NULL;
+  }
+
+  stored = (m->dupe == NULL) ? item : m->dupe(item);
+  if(stored == NULL) {
+    m->hstatus.herror |= hshNOMEM;
+    return NULL;
+  }
+
+  h = freeslot(m, hv);
+  if(m->ctrl[h] == SWISS_EMPTY) {
+    m->used++;
+  } else {
+    m->hstatus.hdeleted--;
+  }
+  m->ctrl[h] = H2(hshmix(hv));
+  m->items[h] = stored;
+  m->hstatus.hentries++;
+
+  return stored;
+}
+
+void *swisstable_remove(swisstable *m, void *item)
+{
+  unsigned long h;
+  unsigned char *group;
+  void *olditem;
+
+  if(m == NULL) {
+    return NULL;
+  }
+
+  h = locate(m, item, m->hash(item));
+  if(h >= m->size) {
+    return NULL;
+  }
+
+  olditem = m->items[h];
+  m->items[h] = NULL;
+  m->hstatus.hentries--;
+
+  /* a probe never goes past a group that has an empty slot, so */
+  /* in such a group the slot can simply become empty again     */
+  group = m->ctrl + (h & ~(unsigned long)(SWISSTABLE_GROUP - 1));
+  if(matchbyte(group, SWISS_EMPTY)) {
+    m->ctrl[h] = SWISS_EMPTY;
+    m->used--;
+  } else {
+    m->ctrl[h] = SWISS_DELETED;
+    m->hstatus.hdeleted++;
+  }
+
+  return olditem;
+}
+
+int swisstable_foreach(swisstable *m, hshexecfn exec, void *datum)
+{
+  unsigned long i;
+  int err;
+
+  if((m == NULL) ||
+     (exec == NULL)) {
+    return -1;
+  }
+
+  for(i = 0; i < m->size; i++) {
+    if(!(m->ctrl[i] & 0x80)) {
+      err = exec(m->items[i], datum);
+      if(err != 0) {
+	return err;
+      }
+    }
+  }
+
+  return 0;
+}
+
+hshstats *swisstable_stats(swisstable *m)
+{
+  if(m == NULL) {
+    return NULL;
+  }
+
+  return &(m->hstatus);
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* Bit i of the result is set if control byte i of the group is b */
+static unsigned int matchbyte(const unsigned char *group, unsigned char b)
+{
+#ifdef __SSE2__
+  __m128i ctrl;
+
+  ctrl = _mm_loadu_si128((const __m128i*)group);
+  return (unsigned int)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl,
+					 _mm_set1_epi8((char)b)));
+#else
+  unsigned int mask, i;
+
+  mask = 0;
+  for(i = 0; i < SWISSTABLE_GROUP; i++) {
+    if(group[i] == b) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/* Bit i of the result is set if slot i of the group is EMPTY or */
+/* DELETED, which are the control bytes with the top bit set     */
+static unsigned int matchfree(const unsigned char *group)
+{
+#ifdef __SSE2__
+  return (unsigned int)_mm_movemask_epi8(
+    _mm_loadu_si128((const __m128i*)group));
+#else
+  unsigned int mask, i;
+
+  mask = 0;
+  for(i = 0; i < SWISSTABLE_GROUP; i++) {
+    if(group[i] & 0x80) {
+      mask |= 1u << i;
+    }
+  }
+  return mask;
+#endif
+}
+
+/* Index of the lowest set bit of a non-zero mask */
+static unsigned int firstbit(unsigned int mask)
+{
+#ifdef __GNUC__
+  return (unsigned int)__builtin_ctz(mask);
+#else
+  unsigned int i;
+
+  for(i = 0; !(mask & 1); i++) {
+    mask >>= 1;
+  }
+  return i;
+#endif
+}
+
+/* Find the slot holding item, or return size.  Groups are     */
+/* visited in triangular steps, which covers all of them when  */
+/* there are a power of 2, until one with an empty slot.       */
+static unsigned long locate(swisstable *m, void *item, unsigned long hv)
+{
+  unsigned long mh, g, gmask, step, base;
+  unsigned int mask, b;
+  unsigned char h2;
+
+  mh = hshmix(hv);
+  h2 = H2(mh);
+  gmask = m->size / SWISSTABLE_GROUP - 1;
+  g = H1(mh) & gmask;
+
+  for(step = 1; ; step++) {
+    m->hstatus.probes++;
+    base = g * SWISSTABLE_GROUP;
+
+    for(mask = matchbyte(m->ctrl + base, h2); mask; mask &= mask - 1) {
+      b = firstbit(mask);
+      if(0 == m->cmp(m->items[base + b], item)) {
+	return base + b;
+      }
+    }
+
+    if(matchbyte(m->ctrl + base, SWISS_EMPTY)) {
+      return m->size;
+    }
+
+    m->hstatus.misses++;
+    g = (g + step) & gmask;
+  }
+}
+
+/* The first EMPTY or DELETED slot along hv's probe sequence */
+static unsigned long freeslot(swisstable *m, unsigned long hv)
+{
+  unsigned long g, gmask, step;
+  unsigned int mask;
+
+  gmask = m->size / SWISSTABLE_GROUP - 1;
+  g = H1(hshmix(hv)) & gmask;
+
+  for(step = 1; ; step++) {
+    mask = matchfree(m->ctrl + g * SWISSTABLE_GROUP);
+    if(mask) {
+      return g * SWISSTABLE_GROUP + firstbit(mask);
+    }
+    g = (g + step) & gmask;
+  }
+}
+
+/* Reinsert every item into a new table, doubled as often as */
+/* needed to leave it no more than half full.  DELETED slots */
+/* are dropped on the way.                                   */
+static int rebuild(swisstable *m)
+{
+  unsigned char *oldctrl;
+  void **olditems;
+  unsigned long oldsize, newsize, i, h, hv;
+
+  oldctrl = m->ctrl;
+  olditems = m->items;
+  oldsize = m->size;
+
+  newsize = oldsize;
+  while(TTHRESH(newsize) / 2 < m->hstatus.hentries + 1) {
+    if((newsize << 1) < newsize) {
+      return 0;
+    }
+    newsize <<= 1;
+  }
+
+  if(!newtbl(m, newsize)) {
+    return 0;
+  }
+
+  for(i = 0; i < oldsize; i++) {
+    if(!(oldctrl[i] & 0x80)) {
+      hv = m->hash(olditems[i]);
+      h = freeslot(m, hv);
+      m->ctrl[h] = oldctrl[i];
+      m->items[h] = olditems[i];
+      m->used++;
+    }
+  }
+  m->hstatus.hdeleted = 0;
+
+  free(oldctrl);
+  free(olditems);
+  return 1;
+}
+
+/* Make an all EMPTY table of size slots current.  The old */
+/* one is left to the caller.  Returns 0 if out of memory. */
+static int newtbl(swisstable *m, unsigned long size)
+{
+  unsigned char *ctrl;
+  void **items;
+  unsigned long i;
+
+  ctrl = malloc(size);
+  items = calloc(size, sizeof(*items));
+  if((ctrl == NULL) ||
+     (items == NULL)) {
+    free(ctrl);
+    free(items);
+    return 0;
+  }
+
+  for(i = 0; i < size; i++) {
+    ctrl[i] = SWISS_EMPTY;
+  }
+
+  m->ctrl = ctrl;
+  m->items = items;
+  m->size = size;
+  m->used = 0;
+  return 1;
+}
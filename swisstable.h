@@ -0,0 +1,124 @@
+/**
+ * @file   swisstable.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 13:02:44 2026
+ *
+ * @brief A hash map that probes 16 slots at a time. Each slot has a
+ * control byte holding 7 bits of its item's hash, and a whole group
+ * of control bytes is matched in one SSE2 compare. Uses the same
+ * item callbacks as hashtable.
+ *
+ *
+ */
+
+#ifndef _SWISSTABLE_H_
+#define _SWISSTABLE_H_
+
+#include "hashtable.h"
+
+/* The table is split into groups of SWISSTABLE_GROUP slots.  A     */
+/* probe loads the group's control bytes and compares them all at   */
+/* once against the 7 hash bits it is looking for; cmp is only      */
+/* called on the slots that match, which for a miss is almost none. */
+/* Probing stops at the first group with an empty slot.  Without    */
+/* SSE2 the same matching is done a byte at a time.                 */
+
+/* Only hash is needed: the bits to pick a group and the bits kept  */
+/* in the control byte both come from hshmix() of its value.        */
+
+#define SWISSTABLE_GROUP 16
+
+/* control byte values; a full slot holds 7 hash bits, top bit clear */
+#define SWISS_EMPTY   0x80
+#define SWISS_DELETED 0xFE
+
+typedef struct swisstable_s swisstable;
+struct swisstable_s {
+  unsigned char *ctrl;         /* one control byte per slot */
+  void **items;                /* the slots */
+  unsigned long size;          /* slots, a power of 2 and >= 1 group */
+  unsigned long used;          /* full and DELETED slots */
+  hshfn hash;
+  hshcmpfn cmp;
+  hshdupfn dupe;
+  hshfreefn undupe;
+  hshstats hstatus;            /* probes counts groups looked at */
+};
+
+/**
+ * Creates a new group probing hashtable, returns a pointer to it, or
+ * NULL on failure
+ *
+ * @param hash the hashing function
+ * @param cmp a comparator function
+ * @param dupe a duplication function
+ * @param undupe a freeing function
+ *
+ * @return pointer to the hashtable in memory, or NULL on failure
+ */
+swisstable *swisstable_new(hshfn hash, hshcmpfn cmp,
+			   hshdupfn dupe, hshfreefn undupe);
+
+/**
+ * Frees the memory associated with a table. Will accept NULL
+ * gracefully
+ *
+ * @param m the table
+ */
+void swisstable_free(swisstable *m);
+
+/**
+ * Locates an item in the table, and returns a pointer to it.
+ *
+ * @param m the table
+ * @param item the item you are looking for
+ *
+ * @return a pointer to the item in the table, or NULL on failure/not
+ *         found
+ */
+void *swisstable_find(swisstable *m, void *item);
+
+/**
+ * Insert an item into the table, unless an equal one is there
+ *
+ * @param m the table
+ * @param item the item to insert
+ *
+ * @return the address of the stored item, or NULL on failure
+ */
+void *swisstable_insert(swisstable *m, void *item);
+
+/**
+ * Removes an entry from the table. You are responsible for freeing
+ * the returned item, normally by passing it to your freefn.
+ *
+ * @param m the table
+ * @param item the item to remove
+ *
+ * @return the address of the item in memory, or NULL on failure/not
+ *         found
+ */
+void *swisstable_remove(swisstable *m, void *item);
+
+/**
+ * Executes exec for each item in the table (no guaranteed order)
+ *
+ * @param m the table
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure
+ * @param datum data that the exec function will have access to.
+ *
+ * @return 0 on success, other on failure
+ */
+int swisstable_foreach(swisstable *m, hshexecfn exec, void *datum);
+
+/**
+ * Return statistics for this table
+ *
+ * @param m the table
+ *
+ * @return statistics for the table
+ */
+hshstats *swisstable_stats(swisstable *m);
+
+#endif /* _SWISSTABLE_H_ */
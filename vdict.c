@@ -0,0 +1,779 @@
+/**
+ * @file   vdict.c
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 18:54:26 2026
+ *
+ * @brief  A versioned dictionary with lock-free readers. More
+ * documentation in vdict.h
+ *
+ *
+ */
+
+#include "vdict.h"
+#include "hash.h"
+
+/* What one change allocates and what it leaves unreachable.  A    */
+/* change touches one path, and at each level of it allocates at   */
+/* most a copy of the node and a node splitting two keys apart,    */
+/* and makes garbage of at most the old node and a node collapsed  */
+/* away; on top of that come an item, a bucket and a version.      */
+#define EDITMAX (2 * VDICT_MAXDEPTH + 4)
+
+typedef struct edit_s edit;
+struct edit_s {
+  void *born[EDITMAX];       /* freed if the change fails */
+  int nborn;
+  void *dead[EDITMAX];       /* retired once it is published */
+  int ndead;
+};
+
+/**
+ * Private functions
+ *
+ */
+static void *grab(edit *e, size_t size);
+static void bury(edit *e, void *p);
+static void abandon(edit *e);
+static int publish(vdict *d, edit *e, vdict_node *root,
+		   unsigned long count);
+static void retire(vdict *d, edit *e);
+static vdict_node *newnode(edit *e, unsigned long bitmap);
+static vdict_bucket *newbucket(edit *e, unsigned long hval,
+			       unsigned int n);
+static vdict_node *withkid(edit *e, vdict_node *n, unsigned long bit,
+			   void *kid);
+static vdict_node *withoutkid(edit *e, vdict_node *n, unsigned long bit);
+static vdict_node *pair(edit *e, void *a, unsigned long ha,
+			vdict_item *b, unsigned int shift);
+static vdict_node *put(edit *e, vdict_node *n, vdict_item *it,
+		       unsigned int shift, int *added);
+static void *putbucket(edit *e, vdict_bucket *b, vdict_item *it,
+		       int *added);
+static vdict_node *take(edit *e, vdict_node *n, unsigned long hv,
+			const char *key, size_t klen, unsigned int shift);
+static void *takebucket(edit *e, vdict_bucket *b, unsigned long hv,
+			const char *key, size_t klen);
+static int samekey(const vdict_item *it, unsigned long hv,
+		   const char *key, size_t klen);
+static int walk(void *p, hshexecfn exec, void *datum);
+static void freetrie(void *p);
+static unsigned int popcount(unsigned long x);
+
+/* The kind of thing a trie pointer points at */
+#define KIND(p) (*(const int*)(p))
+
+/* The bit standing for hv's kid in a node shift bits down */
+#define KIDBIT(hv, shift) (1UL << (((hv) >> (shift)) & (VDICT_FANOUT - 1)))
+
+/* Where the kid for bit sits in n's kids */
+#define KIDPOS(n, bit) popcount((n)->bitmap & ((bit) - 1))
+
+
+vdict *vdict_new(void)
+{
+  vdict *d;
+  vdict_version *v;
+  edit e;
+
+  d = calloc(1, sizeof(*d));
+  if(d == NULL) {
+    return NULL;
+  }
+
+  e.nborn = e.ndead = 0;
+  v = grab(&e, sizeof(*v));
+  if(v != NULL) {
+    v->root = newnode(&e, 0);
+  }
+  if((v == NULL) ||
+     (v->root == NULL)) {
+    abandon(&e);
+    free(d);
+    return NULL;
+  }
+  v->count = 0;
+  v->serial = 1;
+
+  d->readers = epoch_new();
+  if(d->readers == NULL) {
+    abandon(&e);
+    free(d);
+    return NULL;
+  }
+
+  if(pthread_mutex_init(&d->wlock, NULL) != 0) {
+    epoch_free(d->readers);
+    abandon(&e);
+    free(d);
+    return NULL;
+  }
+
+  d->cur = v;
+  return d;
+}
+
+void vdict_free(vdict *d)
+{
+  if(d == NULL) {
+    return;
+  }
+
+  freetrie(d->cur->root);
+  free(d->cur);
+
+  /* releases the versions and nodes still waiting on readers */
+  epoch_free(d->readers);
+
+  pthread_mutex_destroy(&d->wlock);
+  free(d);
+}
+
+epoch_thread *vdict_register(vdict *d)
+{
+  if(d == NULL) {
+    return NULL;
+  }
+
+  return epoch_register(d->readers);
+}
+
+void vdict_unregister(epoch_thread *t)
+{
+  epoch_unregister(t);
+}
+
+const vdict_version *vdict_enter(vdict *d, epoch_thread *t)
+{
+  epoch_enter(d->readers, t);
+  return __atomic_load_n(&d->cur, __ATOMIC_ACQUIRE);
+}
+
+void vdict_exit(epoch_thread *t)
+{
+  epoch_exit(t);
+}
+
+const char *vdict_get(const vdict_version *v, const char *key)
+{
+  if(key == NULL) {
+    return NULL;
+  }
+
+  return vdict_get_n(v, key, strlen(key), NULL);
+}
+
+const char *vdict_get_n(const vdict_version *v, const char *key,
+			size_t klen, size_t *vlen)
+{
+  const vdict_node *n;
+  const vdict_bucket *b;
+  const vdict_item *it;
+  const void *p;
+  unsigned long hv, bit;
+  unsigned int shift, i;
+
+  if((v == NULL) ||
+     (key == NULL)) {
+    return NULL;
+  }
+
+  hv = (unsigned long)hash_string64_n(key, klen);
+
+  /* nodes are never changed once published, so nothing here */
+  /* needs to be read atomically                              */
+  p = v->root;
+  for(shift = 0; KIND(p) == VDICT_NODE; shift += VDICT_BITS) {
+    n = (const vdict_node*)p;
+    bit = KIDBIT(hv, shift);
+    if(!(n->bitmap & bit)) {
+      return NULL;
+    }
+    p = n->kids[KIDPOS(n, bit)];
+  }
+
+  it = NULL;
+  if(KIND(p) == VDICT_ITEM) {
+    if(samekey((const vdict_item*)p, hv, key, klen)) {
+      it = (const vdict_item*)p;
+    }
+  } else {
+    b = (const vdict_bucket*)p;
+    for(i = 0; (it == NULL) && (i < b->n); i++) {
+      if(samekey(b->items[i], hv, key, klen)) {
+	it = b->items[i];
+      }
+    }
+  }
+
+  if(it == NULL) {
+    return NULL;
+  }
+
+  if(vlen != NULL) {
+    *vlen = it->vlen;
+  }
+  return it->value;
+}
+
+int vdict_foreach(const vdict_version *v, hshexecfn exec, void *datum)
+{
+  if((v == NULL) ||
+     (exec == NULL)) {
+    return -1;
+  }
+
+  return walk(v->root, exec, datum);
+}
+
+int vdict_set(vdict *d, const char *key, const char *value)
+{
+  if((key == NULL) ||
+     (value == NULL)) {
+    return -1;
+  }
+
+  return vdict_set_n(d, key, strlen(key), value, strlen(value));
+}
+
+int vdict_set_n(vdict *d, const char *key, size_t klen,
+		const char *value, size_t vlen)
+{
+  vdict_item *it;
+  vdict_node *root;
+  edit e;
+  int added;
+
+  if((d == NULL) ||
+     (key == NULL) ||
+     (value == NULL) ||
+     (klen > ((size_t)-1) - sizeof(*it) - 2) ||
+     (vlen > ((size_t)-1) - sizeof(*it) - 2 - klen)) {
+    return -1;
+  }
+
+  /* the item is made before taking the lock, it is private yet */
+  e.nborn = e.ndead = 0;
+  it = grab(&e, sizeof(*it) + klen + 1 + vlen + 1);
+  if(it == NULL) {
+    return -1;
+  }
+  it->kind = VDICT_ITEM;
+  it->hval = (unsigned long)hash_string64_n(key, klen);
+  it->key = (char*)(it + 1);
+  it->value = it->key + klen + 1;
+  it->klen = klen;
+  it->vlen = vlen;
+  memcpy(it->key, key, klen);
+  it->key[klen] = '\0';
+  memcpy(it->value, value, vlen);
+  it->value[vlen] = '\0';
+
+  pthread_mutex_lock(&d->wlock);
+  root = put(&e, d->cur->root, it, 0, &added);
+  if((root == NULL) ||
+     (publish(d, &e, root, d->cur->count + added) != 0)) {
+    pthread_mutex_unlock(&d->wlock);
+    abandon(&e);
+    return -1;
+  }
+  pthread_mutex_unlock(&d->wlock);
+
+  retire(d, &e);
+  return 0;
+}
+
+int vdict_remove(vdict *d, const char *key)
+{
+  if(key == NULL) {
+    return -1;
+  }
+
+  return vdict_remove_n(d, key, strlen(key));
+}
+
+int vdict_remove_n(vdict *d, const char *key, size_t klen)
+{
+  vdict_node *root;
+  unsigned long hv;
+  edit e;
+
+  if((d == NULL) ||
+     (key == NULL)) {
+    return -1;
+  }
+
+  hv = (unsigned long)hash_string64_n(key, klen);
+  e.nborn = e.ndead = 0;
+
+  pthread_mutex_lock(&d->wlock);
+  root = take(&e, d->cur->root, hv, key, klen, 0);
+  if(root == d->cur->root) {
+    /* not there, nothing was made or unlinked */
+    pthread_mutex_unlock(&d->wlock);
+    return 0;
+  }
+  if((root == NULL) ||
+     (publish(d, &e, root, d->cur->count - 1) != 0)) {
+    pthread_mutex_unlock(&d->wlock);
+    abandon(&e);
+    return -1;
+  }
+  pthread_mutex_unlock(&d->wlock);
+
+  retire(d, &e);
+  return 1;
+}
+
+
+/**
+ * Private functions
+ *
+ */
+
+/* malloc, remembering the memory as part of the change */
+static void *grab(edit *e, size_t size)
+{
+  void *p;
+
+  p = malloc(size);
+  if(p != NULL) {
+    e->born[e->nborn++] = p;
+  }
+
+  return p;
+}
+
+/* Note p as unreachable once the change is published */
+static void bury(edit *e, void *p)
+{
+  e->dead[e->ndead++] = p;
+}
+
+/* Undo a change that was never published.  What it would */
+/* have unlinked is still in use, and is left alone.       */
+static void abandon(edit *e)
+{
+  int i;
+
+  for(i = 0; i < e->nborn; i++) {
+    free(e->born[i]);
+  }
+  e->nborn = e->ndead = 0;
+}
+
+/* Make root, holding count keys, the current version.  The */
+/* old version becomes garbage with the rest.  Called with  */
+/* the lock held.  Returns 0 on success.                    */
+static int publish(vdict *d, edit *e, vdict_node *root,
+		   unsigned long count)
+{
+  vdict_version *v;
+
+  v = grab(e, sizeof(*v));
+  if(v == NULL) {
+    return -1;
+  }
+
+  v->root = root;
+  v->count = count;
+  v->serial = d->cur->serial + 1;
+
+  bury(e, d->cur);
+  __atomic_store_n(&d->cur, v, __ATOMIC_RELEASE);
+  return 0;
+}
+
+/* Hand a published change's garbage to the readers' epoch */
+static void retire(vdict *d, edit *e)
+{
+  int i;
+
+  for(i = 0; i < e->ndead; i++) {
+    epoch_retire(d->readers, e->dead[i], free);
+  }
+  epoch_reclaim(d->readers);
+}
+
+/* A node with room for a kid for each bit of bitmap */
+static vdict_node *newnode(edit *e, unsigned long bitmap)
+{
+  vdict_node *n;
+
+  n = grab(e, sizeof(*n) + popcount(bitmap) * sizeof(void*));
+  if(n == NULL) {
+    return NULL;
+  }
+
+  n->kind = VDICT_NODE;
+  n->bitmap = bitmap;
+  n->kids = (void**)(n + 1);
+  return n;
+}
+
+/* A bucket with room for n items */
+static vdict_bucket *newbucket(edit *e, unsigned long hval,
+			       unsigned int n)
+{
+  vdict_bucket *b;
+
+  b = grab(e, sizeof(*b) + n * sizeof(vdict_item*));
+  if(b == NULL) {
+    return NULL;
+  }
+
+  b->kind = VDICT_BUCKET;
+  b->hval = hval;
+  b->n = n;
+  b->items = (vdict_item**)(b + 1);
+  return b;
+}
+
+/* A copy of n with kid as its kid for bit, added or replaced */
+static vdict_node *withkid(edit *e, vdict_node *n, unsigned long bit,
+			   void *kid)
+{
+  vdict_node *c;
+  unsigned int pos, nkids, had;
+
+  c = newnode(e, n->bitmap | bit);
+  if(c == NULL) {
+    return NULL;
+  }
+
+  pos = KIDPOS(n, bit);
+  nkids = popcount(n->bitmap);
+  had = (n->bitmap & bit) ? 1 : 0;
+
+  memcpy(c->kids, n->kids, pos * sizeof(void*));
+  c->kids[pos] = kid;
+  memcpy(c->kids + pos + 1, n->kids + pos + had,
+	 (nkids - pos - had) * sizeof(void*));
+
+  bury(e, n);
+  return c;
+}
+
+/* A copy of n without its kid for bit */
+static vdict_node *withoutkid(edit *e, vdict_node *n, unsigned long bit)
+{
+  vdict_node *c;
+  unsigned int pos, nkids;
+
+  c = newnode(e, n->bitmap & ~bit);
+  if(c == NULL) {
+    return NULL;
+  }
+
+  pos = KIDPOS(n, bit);
+  nkids = popcount(n->bitmap);
+
+  memcpy(c->kids, n->kids, pos * sizeof(void*));
+  memcpy(c->kids + pos, n->kids + pos + 1,
+	 (nkids - pos - 1) * sizeof(void*));
+
+  bury(e, n);
+  return c;
+}
+
+/* Nodes from shift bits down that keep a (an item or bucket  */
+/* whose hash is ha) and b apart.  The hashes differ, so they */
+/* part at the latest where the last bits are used.           */
+static vdict_node *pair(edit *e, void *a, unsigned long ha,
+			vdict_item *b, unsigned int shift)
+{
+  vdict_node *n, *sub;
+  unsigned long abit, bbit;
+
+  abit = KIDBIT(ha, shift);
+  bbit = KIDBIT(b->hval, shift);
+
+  if(abit == bbit) {
+    sub = pair(e, a, ha, b, shift + VDICT_BITS);
+    if(sub == NULL) {
+      return NULL;
+    }
+    n = newnode(e, abit);
+    if(n != NULL) {
+      n->kids[0] = sub;
+    }
+    return n;
+  }
+
+  n = newnode(e, abit | bbit);
+  if(n != NULL) {
+    n->kids[(abit < bbit) ? 0 : 1] = a;
+    n->kids[(abit < bbit) ? 1 : 0] = b;
+  }
+  return n;
+}
+
+/* A copy of the path through n, shift bits down, with it in  */
+/* place of any item with its key.  *added says whether there */
+/* was none.  Returns NULL if out of memory.                  */
+static vdict_node *put(edit *e, vdict_node *n, vdict_item *it,
+		       unsigned int shift, int *added)
+{
+  unsigned long bit;
+  vdict_item *old;
+  vdict_bucket *b;
+  void *kid, *sub;
+
+  bit = KIDBIT(it->hval, shift);
+  if(!(n->bitmap & bit)) {
+    *added = 1;
+    return withkid(e, n, bit, it);
+  }
+
+  kid = n->kids[KIDPOS(n, bit)];
+  switch(KIND(kid)) {
+  case VDICT_NODE:
+    sub = put(e, (vdict_node*)kid, it, shift + VDICT_BITS, added);
+    break;
+
+  case VDICT_ITEM:
+    old = (vdict_item*)kid;
+    if(old->hval != it->hval) {
+      *added = 1;
+      sub = pair(e, old, old->hval, it, shift + VDICT_BITS);
+    } else if(samekey(old, it->hval, it->key, it->klen)) {
+      *added = 0;
+      bury(e, old);
+      sub = it;
+    } else {
+      /* the whole hash is the same */
+      *added = 1;
+      b = newbucket(e, it->hval, 2);
+      if(b != NULL) {
+	b->items[0] = old;
+	b->items[1] = it;
+      }
+      sub = b;
+    }
+    break;
+
+  default:
+    b = (vdict_bucket*)kid;
+    if(b->hval != it->hval) {
+      *added = 1;
+      sub = pair(e, b, b->hval, it, shift + VDICT_BITS);
+    } else {
+      sub = putbucket(e, b, it, added);
+    }
+    break;
+  }
+
+  if(sub == NULL) {
+    return NULL;
+  }
+  return withkid(e, n, bit, sub);
+}
+
+/* A copy of b with it in place of any item with its key */
+static void *putbucket(edit *e, vdict_bucket *b, vdict_item *it,
+		       int *added)
+{
+  vdict_bucket *c;
+  unsigned int i;
+
+  for(i = 0; i < b->n; i++) {
+    if(samekey(b->items[i], it->hval, it->key, it->klen)) {
+      break;
+    }
+  }
+
+  *added = (i == b->n);
+  c = newbucket(e, b->hval, b->n + *added);
+  if(c == NULL) {
+    return NULL;
+  }
+
+  memcpy(c->items, b->items, b->n * sizeof(vdict_item*));
+  if(!*added) {
+    bury(e, b->items[i]);
+  }
+  c->items[i] = it;
+
+  bury(e, b);
+  return c;
+}
+
+/* A copy of the path through n, shift bits down, without the   */
+/* key.  Nodes left with a single item or bucket are folded     */
+/* into their parent, so the trie is shaped the same however it */
+/* got its keys.  Returns n itself if the key is not there, or  */
+/* NULL if out of memory.                                       */
+static vdict_node *take(edit *e, vdict_node *n, unsigned long hv,
+			const char *key, size_t klen, unsigned int shift)
+{
+  unsigned long bit;
+  vdict_node *subn;
+  void *kid, *sub;
+
+  bit = KIDBIT(hv, shift);
+  if(!(n->bitmap & bit)) {
+    return n;
+  }
+
+  kid = n->kids[KIDPOS(n, bit)];
+  switch(KIND(kid)) {
+  case VDICT_NODE:
+    subn = take(e, (vdict_node*)kid, hv, key, klen, shift + VDICT_BITS);
+    if((subn == NULL) ||
+       (subn == kid)) {
+      return (subn == NULL) ? NULL : n;
+    }
+    if(subn->bitmap == 0) {
+      bury(e, subn);
+      return withoutkid(e, n, bit);
+    }
+    if((popcount(subn->bitmap) == 1) &&
+       (KIND(subn->kids[0]) != VDICT_NODE)) {
+      bury(e, subn);
+      sub = subn->kids[0];
+    } else {
+      sub = subn;
+    }
+    break;
+
+  case VDICT_ITEM:
+    if(!samekey((vdict_item*)kid, hv, key, klen)) {
+      return n;
+    }
+    bury(e, kid);
+    return withoutkid(e, n, bit);
+
+  default:
+    sub = takebucket(e, (vdict_bucket*)kid, hv, key, klen);
+    if(sub == kid) {
+      return n;
+    }
+    break;
+  }
+
+  if(sub == NULL) {
+    return NULL;
+  }
+  return withkid(e, n, bit, sub);
+}
+
+/* b without the key: a smaller bucket, or the one item left.  */
+/* Returns b itself if the key is not there, or NULL if out of */
+/* memory.                                                     */
+static void *takebucket(edit *e, vdict_bucket *b, unsigned long hv,
+			const char *key, size_t klen)
+{
+  vdict_bucket *c;
+  unsigned int i;
+
+  for(i = 0; i < b->n; i++) {
+    if(samekey(b->items[i], hv, key, klen)) {
+      break;
+    }
+  }
+  if(i == b->n) {
+    return b;
+  }
+
+  if(b->n == 2) {
+    bury(e, b->items[i]);
+    bury(e, b);
+    return b->items[1 - i];
+  }
+
+  c = newbucket(e, b->hval, b->n - 1);
+  if(c == NULL) {
+    return NULL;
+  }
+  memcpy(c->items, b->items, i * sizeof(vdict_item*));
+  memcpy(c->items + i, b->items + i + 1,
+	 (b->n - i - 1) * sizeof(vdict_item*));
+
+  bury(e, b->items[i]);
+  bury(e, b);
+  return c;
+}
+
+static int samekey(const vdict_item *it, unsigned long hv,
+		   const char *key, size_t klen)
+{
+  return (it->hval == hv) &&
+    (it->klen == klen) &&
+    (memcmp(it->key, key, klen) == 0);
+}
+
+/* exec every item under p */
+static int walk(void *p, hshexecfn exec, void *datum)
+{
+  vdict_node *n;
+  vdict_bucket *b;
+  unsigned int i, nkids;
+  int err;
+
+  switch(KIND(p)) {
+  case VDICT_NODE:
+    n = (vdict_node*)p;
+    nkids = popcount(n->bitmap);
+    for(i = 0; i < nkids; i++) {
+      err = walk(n->kids[i], exec, datum);
+      if(err != 0) {
+	return err;
+      }
+    }
+    return 0;
+
+  case VDICT_ITEM:
+    return exec(p, datum);
+
+  default:
+    b = (vdict_bucket*)p;
+    for(i = 0; i < b->n; i++) {
+      err = exec(b->items[i], datum);
+      if(err != 0) {
+	return err;
+      }
+    }
+    return 0;
+  }
+}
+
+/* free p and everything under it */
+static void freetrie(void *p)
+{
+  vdict_node *n;
+  vdict_bucket *b;
+  unsigned int i, nkids;
+
+  switch(KIND(p)) {
+  case VDICT_NODE:
+    n = (vdict_node*)p;
+    nkids = popcount(n->bitmap);
+    for(i = 0; i < nkids; i++) {
+      freetrie(n->kids[i]);
+    }
+    break;
+
+  case VDICT_BUCKET:
+    b = (vdict_bucket*)p;
+    for(i = 0; i < b->n; i++) {
+      free(b->items[i]);
+    }
+    break;
+  }
+
+  free(p);
+}
+
+/* The number of bits set in x */
+static unsigned int popcount(unsigned long x)
+{
+#ifdef __GNUC__
+  return (unsigned int)__builtin_popcountl(x);
+#else
+  unsigned int n;
+
+  for(n = 0; x != 0; x &= x - 1) {
+    n++;
+  }
+  return n;
+#endif
+}
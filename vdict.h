@@ -0,0 +1,222 @@
+/**
+ * @file   vdict.h
+ * @author Adam Risi <ajrisi@gmail.com>
+ * @date   Fri Oct 16 18:31:12 2026
+ *
+ * @brief A versioned dictionary (string -> string) for data that is
+ * read all the time and changed rarely. Readers look things up in a
+ * snapshot without locks or waiting; every change builds a new
+ * version, sharing all it did not touch with the old one, and
+ * publishes it in one atomic store.
+ *
+ *
+ */
+
+#ifndef _VDICT_H_
+#define _VDICT_H_
+
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "hashtable.h"
+#include "epoch.h"
+
+/* A version is a hash trie: each node holds up to VDICT_FANOUT     */
+/* kids, picked by the next VDICT_BITS bits of the key's            */
+/* hash_string64_n, and only allocates room for those it has.  A    */
+/* change copies the nodes on the path to the key and nothing else, */
+/* so it costs about log32(n) small allocations.  Keys whose hashes */
+/* are wholly equal share a bucket at the bottom.                   */
+
+/* Readers get a record from vdict_register() and bracket their     */
+/* lookups with vdict_enter() and vdict_exit().  vdict_enter()      */
+/* returns the current version, and everything looked up in it      */
+/* stays put until vdict_exit(), whatever writers do meanwhile.     */
+/* Writers are serialised on a mutex, and what they replace is      */
+/* freed once no reader can still be in a version that had it.      */
+
+#define VDICT_BITS 5
+#define VDICT_FANOUT (1 << VDICT_BITS)
+
+/* levels of nodes it takes to use up a hash */
+#define VDICT_MAXDEPTH ((sizeof(unsigned long) * 8 + VDICT_BITS - 1)	\
+			/ VDICT_BITS)
+
+/* what a trie pointer points at, from the int it starts with */
+#define VDICT_NODE   0
+#define VDICT_ITEM   1
+#define VDICT_BUCKET 2
+
+typedef struct vdict_node_s vdict_node;
+struct vdict_node_s {
+  int kind;                  /* VDICT_NODE */
+  unsigned long bitmap;      /* bit i set if there is a kid for i */
+  void **kids;               /* one per set bit in order, after this */
+};
+
+/* key and value follow the struct, each with a '\0' after it */
+typedef struct vdict_item_s vdict_item;
+struct vdict_item_s {
+  int kind;                  /* VDICT_ITEM */
+  unsigned long hval;        /* hash_string64_n(key, klen) */
+  char *key;
+  char *value;
+  size_t klen;
+  size_t vlen;
+};
+
+typedef struct vdict_bucket_s vdict_bucket;
+struct vdict_bucket_s {
+  int kind;                  /* VDICT_BUCKET */
+  unsigned long hval;        /* of every item in it */
+  unsigned int n;
+  vdict_item **items;        /* after this */
+};
+
+typedef struct vdict_version_s vdict_version;
+struct vdict_version_s {
+  vdict_node *root;
+  unsigned long count;       /* keys in this version */
+  unsigned long serial;      /* 1 for the first, then up by 1 a change */
+};
+
+typedef struct vdict_s vdict;
+struct vdict_s {
+  vdict_version *cur;        /* read without locking */
+  epoch *readers;            /* holds replaced versions and nodes */
+  pthread_mutex_t wlock;     /* serialises writers */
+};
+
+/**
+ * Creates a new, empty versioned dictionary
+ *
+ * @return the dictionary, or NULL on failure
+ */
+vdict *vdict_new(void);
+
+/**
+ * Frees a versioned dictionary. No other thread may be using it.
+ * Will accept NULL gracefully
+ *
+ * @param d the dictionary
+ */
+void vdict_free(vdict *d);
+
+/**
+ * Registers the calling thread as a reader
+ *
+ * @param d the dictionary
+ *
+ * @return the thread's record, or NULL on failure
+ */
+epoch_thread *vdict_register(vdict *d);
+
+/**
+ * Gives up a record from vdict_register
+ *
+ * @param t the record
+ */
+void vdict_unregister(epoch_thread *t);
+
+/**
+ * Starts a run of lookups. Does not block
+ *
+ * @param d the dictionary
+ * @param t the calling thread's record
+ *
+ * @return the current version, good until vdict_exit
+ */
+const vdict_version *vdict_enter(vdict *d, epoch_thread *t);
+
+/**
+ * Ends a run of lookups. Nothing got since vdict_enter may be used
+ * after this
+ *
+ * @param t the calling thread's record
+ */
+void vdict_exit(epoch_thread *t);
+
+/**
+ * Looks up a key in a version
+ *
+ * @param v the version
+ * @param key the key
+ *
+ * @return the value, or NULL if not found
+ */
+const char *vdict_get(const vdict_version *v, const char *key);
+
+/**
+ * Looks up a key of klen bytes in a version
+ *
+ * @param v the version
+ * @param key the key
+ * @param klen the length of the key
+ * @param vlen if not NULL, set to the length of the value found
+ *
+ * @return the value, or NULL if not found
+ */
+const char *vdict_get_n(const vdict_version *v, const char *key,
+			size_t klen, size_t *vlen);
+
+/**
+ * Executes exec for each vdict_item of a version (no guaranteed
+ * order)
+ *
+ * @param v the version
+ * @param exec an exec fn - return 0 for all successes, and something
+ *             else on a failure
+ * @param datum data that the exec function will have access to.
+ *
+ * @return 0 on success, other on failure
+ */
+int vdict_foreach(const vdict_version *v, hshexecfn exec, void *datum);
+
+/**
+ * Sets a key to a value, replacing any value it had, and publishes
+ * the result as a new version
+ *
+ * @param d the dictionary
+ * @param key the key
+ * @param value the value
+ *
+ * @return 0 on success, other on failure
+ */
+int vdict_set(vdict *d, const char *key, const char *value);
+
+/**
+ * Sets a key of klen bytes to a value of vlen bytes, like vdict_set
+ *
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ * @param value the value
+ * @param vlen the length of the value
+ *
+ * @return 0 on success, other on failure
+ */
+int vdict_set_n(vdict *d, const char *key, size_t klen,
+		const char *value, size_t vlen);
+
+/**
+ * Removes a key, publishing a new version if it was there
+ *
+ * @param d the dictionary
+ * @param key the key
+ *
+ * @return 1 if it was removed, 0 if it was not there, -1 on failure
+ */
+int vdict_remove(vdict *d, const char *key);
+
+/**
+ * Removes a key of klen bytes, like vdict_remove
+ *
+ * @param d the dictionary
+ * @param key the key
+ * @param klen the length of the key
+ *
+ * @return 1 if it was removed, 0 if it was not there, -1 on failure
+ */
+int vdict_remove_n(vdict *d, const char *key, size_t klen);
+
+#endif /* _VDICT_H_ */